@@ -2,25 +2,78 @@
 
 /****************************************************************************/
 
+/* 64-bit off_t, for divmnu_file(), where it would be 32 bits. */
+
+#ifndef _FILE_OFFSET_BITS
+# define _FILE_OFFSET_BITS 64
+#endif /* ifndef _FILE_OFFSET_BITS */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "divmnu.h"
+
+#ifdef KD_DIV_TUNE
+# include "divmnu_tune.h"
+#endif /* ifdef KD_DIV_TUNE */
+
+#if defined(__GNUC__) && !defined(__COMPCERT__) && \
+    ( defined(__x86_64__) || defined(__i386__) )
+# define KD_DIV_HAVE_AVX2  1
+# define KD_DIV_HAVE_RDTSC 1
+# include <immintrin.h>
+# include <x86intrin.h>
+#endif /* if defined(__GNUC__) && !defined(__COMPCERT__) && ... */
+
+#if defined(__GNUC__) && !defined(__COMPCERT__) && defined(__x86_64__)
+# define KD_DIV_HAVE_ADX 1
+# include <cpuid.h>
+#endif /* if defined(__GNUC__) && !defined(__COMPCERT__) && ... */
+
+#if defined(__linux__) && !defined(__COMPCERT__)
+# define KD_DIV_HAVE_PERF 1
+# include <linux/perf_event.h>
+# include <sys/ioctl.h>
+# include <sys/syscall.h>
+#endif /* if defined(__linux__) && !defined(__COMPCERT__) */
 
 /****************************************************************************/
 
-#define kd_div_max(x, y) ( (x) > (y) ? (x) : (y) )
+/*
+ * Built as libdivmnu (-DKD_DIV_LIBRARY), only the divmnu_ functions
+ * declared in divmnu.h make up the interface.  The test and benchmark
+ * harness and main() are left out, and everything else that is kept is
+ * KD_DIV_LOCAL, static there, so that libdivmnu.a defines no other
+ * global symbol to clash with the caller's in a static link.
+ */
+
+#ifdef KD_DIV_LIBRARY
+# define KD_DIV_LOCAL static
+#else
+# define KD_DIV_LOCAL
+#endif /* ifdef KD_DIV_LIBRARY */
 
 /****************************************************************************/
 
-unsigned int kd_div_errors = 0;
+#define kd_div_max(x, y) ( (x) > (y) ? (x) : (y) )
 
 /****************************************************************************/
 
-int
+KD_DIV_LOCAL int
 nlz (unsigned x);
 
-int
+KD_DIV_LOCAL int
 nlz (unsigned x)
 {
   int n;
@@ -64,10 +117,12 @@ nlz (unsigned x)
 
 /****************************************************************************/
 
-void
+#ifndef KD_DIV_LIBRARY
+
+KD_DIV_LOCAL void
 dumpit (char *msg, int n, unsigned v[]);
 
-void
+KD_DIV_LOCAL void
 dumpit (char *msg, int n, unsigned v[])
 {
   int i;
@@ -80,6 +135,8 @@ dumpit (char *msg, int n, unsigned v[])
   (void)fprintf (stderr, "\n");
 }
 
+#endif /* ifndef KD_DIV_LIBRARY */
+
 /****************************************************************************/
 
 typedef struct
@@ -90,10 +147,10 @@ typedef struct
   char pad[3];
 } divrem_t;
 
-divrem_t
+KD_DIV_LOCAL divrem_t
 divrem_64_by_32 (uint64_t n, uint32_t d);
 
-divrem_t
+KD_DIV_LOCAL divrem_t
 divrem_64_by_32 (uint64_t n, uint32_t d)
 {
   if ( (n >> 32) >= d )
@@ -119,11 +176,364 @@ divrem_64_by_32 (uint64_t n, uint32_t d)
 
 /****************************************************************************/
 
-bool
+/*
+ * Counts of the rare paths of divmnu(), kept only when built with
+ * -DKD_DIV_STATS: divisions that reach divmnu_core() and a histogram
+ * of their normalization shifts s, quotient digits, qhat adjustments
+ * (steps of the refinement loop, or second corrections of
+ * divrem_96_by_64_preinv()) and a histogram of them per digit,
+ * add-backs after the multiply-and-subtract, and qhat estimates that
+ * overflowed a digit.  Each thread counts into its own kd_div_stats
+ * (except under CompCert, which has no thread-local storage), and
+ * kd_div_stats_merge() adds them into kd_div_stats_total.
+ */
+
+#define KD_DIV_STATS_NCORR 4                 /* Last bin: that or more.   */
+
+typedef struct
+{
+  unsigned long calls;
+  unsigned long digits;
+  unsigned long adjust;
+  unsigned long fixups;
+  unsigned long overflows;
+  unsigned long corrections[KD_DIV_STATS_NCORR];
+  unsigned long shift[32];
+} kd_div_stats_t;
+
+#if defined(__GNUC__) && !defined(__COMPCERT__)
+# define KD_DIV_TLS _Thread_local
+#else
+# define KD_DIV_TLS
+#endif /* if defined(__GNUC__) && !defined(__COMPCERT__) */
+
+#ifdef KD_DIV_STATS
+KD_DIV_LOCAL KD_DIV_TLS kd_div_stats_t kd_div_stats;
+
+# define KD_DIV_COUNT(x) ( (void)kd_div_stats.x++ )
+# define KD_DIV_HIST(h, i)                                                   \
+  ( (void)kd_div_stats.h[ (i) < sizeof (kd_div_stats.h) /                   \
+                                  sizeof (kd_div_stats.h[0])                \
+                            ? (i)                                          \
+                            : sizeof (kd_div_stats.h) /                     \
+                                sizeof (kd_div_stats.h[0]) - 1 ]++ )
+#else
+# define KD_DIV_COUNT(x)   ( (void)0 )
+# define KD_DIV_HIST(h, i) ( (void)0 )
+#endif /* ifdef KD_DIV_STATS */
+
+#if defined(KD_DIV_STATS) && !defined(KD_DIV_LIBRARY)
+
+KD_DIV_LOCAL kd_div_stats_t kd_div_stats_total;
+KD_DIV_LOCAL pthread_mutex_t kd_div_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Add the calling thread's counts into kd_div_stats_total, and clear
+ * them.  Threads that divide call it before they exit.
+ */
+
+KD_DIV_LOCAL void
+kd_div_stats_merge (void);
+
+KD_DIV_LOCAL void
+kd_div_stats_merge (void)
+{
+  const unsigned long *from = (const unsigned long *)&kd_div_stats;
+  unsigned long *to         = (unsigned long *)&kd_div_stats_total;
+  const size_t words        = sizeof (kd_div_stats) / sizeof (*from);
+
+  (void)pthread_mutex_lock (&kd_div_stats_lock);
+
+  for (size_t i = 0; i < words; i++)
+    to[i] += from[i];
+
+  (void)pthread_mutex_unlock (&kd_div_stats_lock);
+
+  (void)memset (&kd_div_stats, 0, sizeof (kd_div_stats));
+}
+
+/*
+ * Merge the calling thread's counts, print kd_div_stats_total under
+ * the heading label, rates per 1000 quotient digits, and clear it.
+ */
+
+KD_DIV_LOCAL void
+kd_div_stats_dump (FILE *fp, const char *label);
+
+KD_DIV_LOCAL void
+kd_div_stats_dump (FILE *fp, const char *label)
+{
+  const kd_div_stats_t *st = &kd_div_stats_total;
+
+  kd_div_stats_merge ();
+
+  double digits = st->digits != 0 ? (double)st->digits : 1.0;
+
+  (void)fprintf (fp, "stats %s: %lu calls, %lu digits, per 1000 digits: "
+                 "%.3f adjust, %.3f fixups, %.3f overflows\n", label,
+                 st->calls, st->digits, 1e3 * (double)st->adjust / digits,
+                 1e3 * (double)st->fixups / digits,
+                 1e3 * (double)st->overflows / digits);
+
+  (void)fprintf (fp, "  adjust/digit:");
+
+  for (int i = 0; i < KD_DIV_STATS_NCORR; i++)
+    (void)fprintf (fp, " %d%s %lu", i, i < KD_DIV_STATS_NCORR - 1 ? ":" : "+:",
+                   st->corrections[i]);
+
+  (void)fprintf (fp, "\n  s:");
+
+  for (int i = 0; i < 32; i++)
+    if (st->shift[i] != 0)
+      (void)fprintf (fp, " %d: %lu", i, st->shift[i]);
+
+  (void)fprintf (fp, "\n");
+
+  (void)pthread_mutex_lock (&kd_div_stats_lock);
+  (void)memset (&kd_div_stats_total, 0, sizeof (kd_div_stats_total));
+  (void)pthread_mutex_unlock (&kd_div_stats_lock);
+}
+
+#endif /* if defined(KD_DIV_STATS) && !defined(KD_DIV_LIBRARY) */
+
+/****************************************************************************/
+
+/*
+ * SVP64 cost model, kept only when built with -DKD_DIV_SVP64, and not
+ * thread-safe.  Each multiply-and-subtract kernel, and the add-back,
+ * counts the operations it models on SVP64 vector hardware: vector
+ * instructions (one per KD_DIV_SV_MAXVL elements), the elements they
+ * process, scalar instructions, and the length of the serial carry
+ * chain in element steps.  A vector instruction whose elements pass a
+ * carry or borrow along adds VL steps to the chain, one whose elements
+ * are independent adds one step per instruction.  Kernels that model
+ * no vector code count their loops as scalar instructions.  See
+ * divmnu_bench_svp64().
+ */
+
+#define KD_DIV_SV_MAXVL 64
+
+typedef struct
+{
+  unsigned long calls;
+  unsigned long vector;
+  unsigned long elements;
+  unsigned long scalar;
+  unsigned long chain;
+} kd_div_svp64_t;
+
+#ifdef KD_DIV_SVP64
+KD_DIV_LOCAL kd_div_svp64_t kd_div_svp64;
+
+# define KD_DIV_SV_CALL(k)                                                   \
+  ( (void)(kd_div_svp64.calls++, kd_div_svp64.scalar += (unsigned long)(k)) )
+# define KD_DIV_SV_VEC(vl, serial)                                           \
+  ( (void)(kd_div_svp64.vector   += ( (unsigned long)(vl) +                 \
+                                      KD_DIV_SV_MAXVL - 1 ) /              \
+                                    KD_DIV_SV_MAXVL,                       \
+           kd_div_svp64.elements += (unsigned long)(vl),                   \
+           kd_div_svp64.chain    += (serial) ? (unsigned long)(vl)          \
+                                             : ( (unsigned long)(vl) +      \
+                                                 KD_DIV_SV_MAXVL - 1 ) /    \
+                                               KD_DIV_SV_MAXVL) )
+# define KD_DIV_SV_SCALAR(k, serial)                                         \
+  ( (void)(kd_div_svp64.scalar += (unsigned long)(k),                      \
+           kd_div_svp64.chain  += (unsigned long)(serial)) )
+#else
+# define KD_DIV_SV_CALL(k)           ( (void)0 )
+# define KD_DIV_SV_VEC(vl, serial)   ( (void)0 )
+# define KD_DIV_SV_SCALAR(k, serial) ( (void)0 )
+#endif /* ifdef KD_DIV_SVP64 */
+
+/****************************************************************************/
+
+/*
+ * Reciprocal of a normalized (high bit set) divisor digit d for
+ * divrem_64_by_32_preinv(): floor((b**2 - 1) / d) - b, b = 2**32.
+ * See Moller and Granlund, "Improved division by invariant integers".
+ */
+
+KD_DIV_LOCAL uint32_t
+reciprocal_word (uint32_t d);
+
+KD_DIV_LOCAL uint32_t
+reciprocal_word (uint32_t d)
+{
+  return (uint32_t)(UINT64_MAX / d - ( (uint64_t)1 << 32 ));
+}
+
+/****************************************************************************/
+
+/*
+ * 2-adic inverse of an odd digit d: d**-1 mod b, b = 2**32.
+ */
+
+KD_DIV_LOCAL uint32_t
+inverse_word (uint32_t d);
+
+KD_DIV_LOCAL uint32_t
+inverse_word (uint32_t d)
+{
+  /* Newton's iteration doubles the correct low bits: 3, 6, 12, 24, 48. */
+
+  uint32_t inv = d;
+
+  for (int i = 0; i < 4; i++)
+    inv *= 2 - d * inv;
+
+  return inv;
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divrem_64_by_32(), but for a normalized d with dinv =
+ * reciprocal_word(d): the quotient digit comes from one multiplication
+ * by dinv plus at most two corrections, without a hardware divide.
+ * It is inline because it sits on the critical path of every digit.
+ */
+
+static inline divrem_t
+divrem_64_by_32_preinv (uint64_t n, uint32_t d, uint32_t dinv)
+{
+  uint32_t n1 = (uint32_t)(n >> 32);
+  uint32_t n0 = (uint32_t)n;
+
+  if (n1 >= d)
+      /* overflow */
+    {
+      return (divrem_t)
+        {
+          .q        = UINT32_MAX,
+          .r        = 0,
+          .overflow = true
+        };
+    }
+
+  uint64_t qq   = (uint64_t)dinv * n1 + n;
+  uint32_t q1   = (uint32_t)(qq >> 32) + 1;
+  uint32_t q0   = (uint32_t)qq;
+  uint32_t r    = n0 - q1 * d;
+
+  /* The first correction is taken about half of the time; no branch. */
+
+  uint32_t mask = -(uint32_t)(r > q0);
+
+  q1 = q1 + mask;
+  r  = r + (mask & d);
+
+  if (r >= d)
+    {
+      q1 = q1 + 1;
+      r  = r - d;
+    }
+
+  return (divrem_t)
+    {
+      .q        = q1,
+      .r        = r,
+      .overflow = false
+    };
+}
+
+/****************************************************************************/
+
+/*
+ * Reciprocal of a normalized two-digit divisor d1 * b + d0 for
+ * divrem_96_by_64_preinv(): floor((b**3 - 1) / (d1 * b + d0)) - b,
+ * found from reciprocal_word(d1) with at most four adjustments (Moller
+ * and Granlund, Algorithm 6).
+ */
+
+KD_DIV_LOCAL uint32_t
+reciprocal_3by2 (uint32_t d1, uint32_t d0);
+
+KD_DIV_LOCAL uint32_t
+reciprocal_3by2 (uint32_t d1, uint32_t d0)
+{
+  uint32_t v = reciprocal_word (d1);
+  uint32_t p = d1 * v + d0;
+
+  if (p < d0)
+    {
+      v = v - 1;
+
+      if (p >= d1)
+        {
+          v = v - 1;
+          p = p - d1;
+        }
+
+      p = p - d1;
+    }
+
+  uint64_t t = (uint64_t)v * d0;
+  uint32_t t1 = (uint32_t)(t >> 32);
+
+  p = p + t1;
+
+  if (p < t1)
+    {
+      v = v - 1;
+
+      if ( ( ( (uint64_t)p << 32 ) | (uint32_t)t ) >=
+           ( ( (uint64_t)d1 << 32 ) | d0 ) )
+        v = v - 1;
+    }
+
+  return v;
+}
+
+/****************************************************************************/
+
+/*
+ * Quotient digit and two-digit remainder of (u2 * b**2 + u1 * b + u0) /
+ * d, for a normalized two-digit d with dinv = reciprocal_3by2(d) and
+ * u2 * b + u1 < d (Moller and Granlund, Algorithm 5).  The first
+ * correction, taken about half of the time, is done with a mask; the
+ * second is almost never needed.
+ */
+
+static inline uint32_t
+divrem_96_by_64_preinv (uint32_t u2, uint32_t u1, uint32_t u0, uint64_t d,
+                        uint32_t dinv, uint64_t *r)
+{
+  uint64_t qq   = (uint64_t)dinv * u2 + ( ( (uint64_t)u2 << 32 ) | u1 );
+  uint32_t q1   = (uint32_t)(qq >> 32);
+  uint32_t q0   = (uint32_t)qq;
+  uint32_t d1   = (uint32_t)(d >> 32);
+  uint32_t r1   = u1 - q1 * d1;
+  uint64_t rr   = ( ( ( (uint64_t)r1 << 32 ) | u0 ) -
+                    (uint64_t)(uint32_t)d * q1 ) - d;
+
+  q1 = q1 + 1;
+
+  uint32_t mask = -(uint32_t)( (uint32_t)(rr >> 32) >= q0 );
+
+  q1 = q1 + mask;
+  rr = rr + ( ( (uint64_t)mask << 32 | mask ) & d );
+
+  if (rr >= d)
+    {
+      KD_DIV_COUNT (adjust);
+      q1 = q1 + 1;
+      rr = rr - d;
+    }
+
+  *r = rr;
+
+  return q1;
+}
+
+/****************************************************************************/
+
+#ifndef KD_DIV_LIBRARY
+
+KD_DIV_LOCAL bool
 bigmul (uint32_t qhat, unsigned product[], unsigned vn[],
         int m, int n);
 
-bool
+KD_DIV_LOCAL bool
 bigmul (uint32_t qhat, unsigned product[], unsigned vn[],
         int m, int n)
 {
@@ -149,13 +559,15 @@ bigmul (uint32_t qhat, unsigned product[], unsigned vn[],
   return carry != 0;
 }
 
+#endif /* ifndef KD_DIV_LIBRARY */
+
 /****************************************************************************/
 
-bool
+KD_DIV_LOCAL bool
 bigadd (unsigned result[], unsigned vn[], unsigned un[],
         int m, int n, bool ca);
 
-bool
+KD_DIV_LOCAL bool
 bigadd (unsigned result[], unsigned vn[], unsigned un[],
         int m, int n, bool ca)
 {
@@ -181,11 +593,11 @@ bigadd (unsigned result[], unsigned vn[], unsigned un[],
 
 /****************************************************************************/
 
-bool
+KD_DIV_LOCAL bool
 bigsub (unsigned result[], unsigned vn[], unsigned un[],
         int m, int n, bool ca);
 
-bool
+KD_DIV_LOCAL bool
 bigsub (unsigned result[], unsigned vn[], unsigned un[],
         int m, int n, bool ca)
 {
@@ -211,11 +623,58 @@ bigsub (unsigned result[], unsigned vn[], unsigned un[],
 
 /****************************************************************************/
 
-bool
+/*
+ * w[0 .. n-1] += a * b[0 .. n-1], in one pass like the mulsub kernels
+ * but adding; returns the word carried out of w[n-1].  This is the row
+ * of bigmulmn() and bigmulhi(), which call it through kd_div_muladd.
+ */
+
+KD_DIV_LOCAL uint32_t
+bigmuladd (uint32_t a, unsigned w[], unsigned b[], int n);
+
+KD_DIV_LOCAL uint32_t
+bigmuladd (uint32_t a, unsigned w[], unsigned b[], int n)
+{
+  uint64_t k = 0;
+
+  for (int i = 0; i < n; i++)
+    {
+      uint64_t t = (uint64_t)a * b[i] + w[i] + k;
+      w[i]       = (uint32_t)t;
+      k          = t >> 32;
+    }
+
+  return (uint32_t)k;
+}
+
+/****************************************************************************/
+
+/*
+ * The multiply-and-subtract code that keeps partial products in a
+ * buffer (bigmulsub() and the madded_subfe kernel below) works over
+ * strips of KD_DIV_STRIP words: the products of a strip are consumed
+ * while they are still in L1, and only the borrow or carry passes on to
+ * the next strip.  Two 512-word arrays are 4 KiB.
+ *
+ * The two-stage kernels run both stages over blocks of KD_DIV_STAGE
+ * words instead.  A block's phi and plo fit in registers, and the first
+ * stage of the next block overlaps the chained second stage of this
+ * one, so they keep up with the fused kernels; over whole strips the
+ * second stage only started once the first had finished.
+ */
+
+#define KD_DIV_STRIP 512
+#define KD_DIV_STAGE 8
+
+/****************************************************************************/
+
+#ifndef KD_DIV_LIBRARY
+
+KD_DIV_LOCAL bool
 bigmulsub (unsigned long long qhat, unsigned vn[], unsigned un[],
            int j, int m, int n);
 
-bool
+KD_DIV_LOCAL bool
 bigmulsub (unsigned long long qhat, unsigned vn[], unsigned un[],
            int j, int m, int n)
 {
@@ -226,882 +685,7698 @@ bigmulsub (unsigned long long qhat, unsigned vn[], unsigned un[],
   (void)m;
   (void)n;
 
-  /* Multiply and subtract. */
+  /* Multiply and subtract, a strip at a time. */
 
-#ifdef __COMPCERT__
-  uint32_t product[1 + 65535 * 4];
-#else
-  uint32_t product[n + 1];
-#endif /* ifdef __COMPCERT__ */
+  uint32_t product[KD_DIV_STRIP];
+  uint32_t carry = 0;
+  bool     ca    = true;
 
+  for (int s0 = 0; s0 <= n; s0 += KD_DIV_STRIP)
+    {
+      int end = n + 1 - s0 < KD_DIV_STRIP ? n + 1 : s0 + KD_DIV_STRIP;
+
+      for (int i = s0; i < end; i++)
+        {
+          uint32_t vn_v   = i < n ? vn[i] : 0;
+          uint64_t value  = (uint64_t)vn_v * (uint32_t)qhat + carry;
+          carry           = (uint32_t)(value >> 32);
+          product[i - s0] = (uint32_t)value;
+        }
 
-  (void)bigmul ( (uint32_t)qhat, product, vn, m, n );
+      ca = bigsub (&un[s0], product, &un[s0], m, end - s0 - 1, ca);
+    }
 
-  bool ca         = bigsub (un, product, un, m, n, true);
   bool need_fixup = !ca;
 
   return need_fixup;
 }
 
+#endif /* ifndef KD_DIV_LIBRARY */
+
 /****************************************************************************/
 
 /*
- * q[0], r[0], u[0], and v[0] contain the LEAST significant words.
- * (The sequence is in little-endian order).
- *
- * This is a fairly precise implementation of Knuth's Algorithm D, for a
- * binary computer with base b = 2**32. The caller supplies:
- *
- *   1. Space q for the quotient, m - n + 1 words (at least one).
- *   2. Space r for the remainder (optional), n words.
- *   3. The dividend u, m words, m >= 1.
- *   4. The divisor v, n words, n >= 2.
- *
- * The most significant digit of the divisor, v[n-1], must be nonzero.
- * The dividend u may have leading zeros; this just makes the algorithm
- * take longer and makes the quotient contain more leading zeros.
- * A value of NULL may be given for the address of the remainder to
- * signify that the caller does not want the remainder.
- *
- *  * The program does not alter the input parameters u and v.
- *
- *  * The quotient and remainder returned may have leading zeros.  The
- *    function itself returns a value of 0 for success and 1 for invalid
- *    parameters (e.g., division by 0).
+ * Multiply-and-subtract kernels.
  *
- *  * For now, we must have m >= n.  Knuth's Algorithm D also requires
- *    that the dividend be at least as long as the divisor.
- *    (In his terms: "m >= 0 (unstated), therefore, m+n >= n." )
+ * Each kernel computes un_j[0..n] -= qhat * vn[0..n-1] for one quotient
+ * digit of divmnu() and returns true if the result went negative, in
+ * which case the caller decrements the quotient digit and adds the
+ * divisor back.  All of the kernels compute the same thing; they differ
+ * only in how the carry or borrow is propagated, and are kept side by
+ * side so that they can be compared against each other in one process.
  */
 
-int
-divmnu (unsigned q[], unsigned r[], const unsigned u[], const unsigned v[],
-        int m, int n);
+typedef bool (*kd_div_mulsub_t) (uint32_t qhat, unsigned un_j[],
+                                 unsigned vn[], int n);
 
-int
-divmnu (unsigned q[], unsigned r[], const unsigned u[], const unsigned v[],
-        int m, int n)
+/****************************************************************************/
+
+KD_DIV_LOCAL bool
+mulsub_original (uint32_t qhat, unsigned un_j[], unsigned vn[], int n);
+
+KD_DIV_LOCAL bool
+mulsub_original (uint32_t qhat, unsigned un_j[], unsigned vn[], int n)
 {
-  const unsigned long long  b = 1LL << 32;   /* Number base (2**32).      */
-  unsigned *un, *vn;                         /* Normalized form of u, v.  */
-  unsigned long long qhat;                   /* Estimated quotient digit. */
-  unsigned long long rhat;                   /* A remainder.              */
-  unsigned long long p = 0UL;                /* Product of two digits.    */
-  long long k, t = 0LL;
-  int s, i, j;
+  unsigned long long p;                      /* Product of two digits.    */
+  long long k, t;
+  int i;
 
-  if (m < n || n <= 0 || v[n - 1] == 0)
-    return 1;                                /* Return if invalid param. */
+  /* Scalar: 6 instructions a word, and 3 for the top word. */
 
-  if (n == 1)
+  KD_DIV_SV_CALL (0);
+  KD_DIV_SV_SCALAR (6 * n + 3, n + 1);
+
+  k = 0;
+
+  for (i = 0; i < n; i++)
     {
-      k = 0;
+      p = qhat * (unsigned long long)vn[i];
 
-      for (j = m - 1; j >= 0; j--)
-        {
-          uint64_t dig2 = ( (uint64_t)k << 32 ) | u[j];
-          q[j]          = (unsigned int)(dig2 / v[0]);
-          k             = dig2 % v[0];
-        }
+      t = (long long)( (long long)un_j[i] -
+             (long long)k -
+             (long long)(p & 0xFFFFFFFFLL) );
 
-      if (r != NULL)
-        r[0] = (unsigned)k;
+      un_j[i] = (unsigned)t;
 
-      return 0;
+      k  = (long long)( (long long)(p >> 32) -
+             (long long)(t >> 32) );
     }
 
-  /*
-   * Normalize by shifting v left just enough so that its high-order
-   * bit is on, and shift u left the same amount. We may have to append a
-   * high-order digit on the dividend; we do that unconditionally.
-   */
+  t       = un_j[n] - k;
+  un_j[n] = (unsigned)t;
 
-  s  = nlz (v[n - 1]);  /* 0 <= s <= 31. */
-#ifdef __COMPCERT__
-  vn = malloc(4 * 65535);
-#else
-  vn = (unsigned *)alloca (4 * n);
-#endif /* ifdef __COMPCERT__ */
+  return t < 0;
+}
 
-  for (i = n - 1; i > 0; i--)
-    vn[i] = (unsigned int)( (v[i] << s) |
-              ( (unsigned long long)v[i - 1] >> (32 - s) ) );
+/****************************************************************************/
 
-  vn[0] = v[0] << s;
+/*
+ * The other kernels.  Without -DKD_DIV_TUNE, the library only ever runs
+ * mulsub_original() or mulsub_mulx_adx(), and leaves them out.
+ */
 
-#ifdef __COMPCERT__
-  un    = malloc(2 * 65535 * 4);
-#else
-  un    = (unsigned *)alloca ( 4 * (m + 1) );
-#endif /* ifdef __COMPCERT__ */
+#if !defined(KD_DIV_LIBRARY) || defined(KD_DIV_TUNE)
 
-  un[m] = (unsigned int)( (unsigned long long)u[m - 1] >> (32 - s) );
+/****************************************************************************/
 
-  for (i = m - 1; i > 0; i--)
-    un[i] = (unsigned int)( (u[i] << s) |
-              ( (unsigned long long)u[i - 1] >> (32 - s) ) );
+KD_DIV_LOCAL bool
+mulsub_sub_mul_borrow (uint32_t qhat, unsigned un_j[], unsigned vn[],
+                       int n);
 
-  un[0] = u[0] << s;
+KD_DIV_LOCAL bool
+mulsub_sub_mul_borrow (uint32_t qhat, unsigned un_j[], unsigned vn[],
+                       int n)
+{
+  uint32_t borrow = 0;
 
-  for (j = m - n; j >= 0; j--)
+  /* One vector multiply-subtract with the borrow chained through. */
+
+  KD_DIV_SV_CALL (2);
+  KD_DIV_SV_VEC (n + 1, true);
+
+  for (int ii = 0; ii <= n; ii++)
     {
+      uint32_t vn_i  = ii < n ? vn[ii] : 0;
+      uint64_t value = un_j[ii] - (uint64_t)qhat * vn_i - borrow;
+      borrow         = -(uint32_t)(value >> 32);
+      un_j[ii]       = (uint32_t)value;
+    }
 
-    uint32_t *un_j = &un[j];
+  return borrow != 0;
+}
 
-    /* Compute estimate qhat of q[j] from top 2 digits. */
+/****************************************************************************/
 
-    uint64_t dig2  = ( (uint64_t)un[j + n] << 32 ) | un[j + n - 1];
-    divrem_t qr    = divrem_64_by_32 (dig2, vn[n - 1]);
-    qhat           = qr.q;
-    rhat           = qr.r;
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry (uint32_t qhat, unsigned un_j[], unsigned vn[],
+                       int n);
 
-    if (qr.overflow)
-      {
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry (uint32_t qhat, unsigned un_j[], unsigned vn[],
+                       int n)
+{
+  uint32_t carry = 1;
 
-        /*
-         * rhat can be bigger than 32-bit when the division overflows;
-         * thus rhat computation cannot be folded into divrem_64_by_32
-         */
+  /* One vector multiply-reverse-subtract with the carry chained. */
 
-        rhat = dig2 - (uint64_t)qr.q * vn[n - 1];
-      }
+  KD_DIV_SV_CALL (2);
+  KD_DIV_SV_VEC (n + 1, true);
 
-again:
+  for (int ii = 0; ii <= n; ii++)
+    {
+      uint32_t vn_i   = ii < n ? vn[ii] : 0;
+      uint64_t result = un_j[ii] +
+                          ~( (uint64_t)qhat * vn_i ) +
+                          carry;
 
-    /* Use 3rd-from-top digit to obtain better accuracy */
+      uint32_t result_high = result >> 32;
 
-    if (rhat < b &&
-     (unsigned)qhat * (unsigned long long)vn[n - 2] >
-     b * rhat + un[j + n - 2])
-      {
-        qhat = qhat - 1;
-        rhat = rhat + vn[n - 1];
+      if (carry <= 1)
+        result_high++;
 
-        if (rhat < b)
-          goto again;
+      carry    = result_high;
+      un_j[ii] = (uint32_t)result;
     }
 
+  return carry != 1;
+}
+
 /****************************************************************************/
 
-#ifdef ORIGINAL
+KD_DIV_LOCAL bool
+mulsub_sub_mul_borrow_2stage (uint32_t qhat, unsigned un_j[],
+                              unsigned vn[], int n);
 
-    k = 0;
+KD_DIV_LOCAL bool
+mulsub_sub_mul_borrow_2stage (uint32_t qhat, unsigned un_j[],
+                              unsigned vn[], int n)
+{
+  uint32_t borrow = 0;
+  uint32_t phi[KD_DIV_STAGE];
+  uint32_t plo[KD_DIV_STAGE];
+  int s0;
 
-    for (i = 0; i < n; i++)
-      {
-        p = (unsigned)qhat * (unsigned long long)vn[i];
+  /* sv.msubx, elements independent, then the chained second stage. */
 
-        t = (long long)( (long long)un[i + j] -
-               (long long)k -
-               (long long)(p & 0xFFFFFFFFLL) );
+  KD_DIV_SV_CALL (2);
+  KD_DIV_SV_VEC (n + 1, false);
+  KD_DIV_SV_VEC (n + 1, true);
 
-        un[i + j] = (unsigned)t;
+  for (s0 = 0; s0 + KD_DIV_STAGE <= n; s0 += KD_DIV_STAGE)
+    {
+      /*
+       * First, perform mul-and-sub and store in split hi-lo
+       * this shows the vectorised sv.msubx which stores 128-bit in
+       * two 64-bit registers
+       */
 
-        k  = (long long)( (long long)(p >> 32) -
-               (long long)(t >> 32) );
-      }
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t value = un_j[s0 + k] - (uint64_t)qhat * vn[s0 + k];
+          plo[k]         = value & 0xffffffffLL;
+          phi[k]         = value >> 32;
+        }
+
+      /*
+       * Second, reconstruct the 64-bit result, subtract borrow,
+       * store top-half (-ve) in new borrow and store low-half as answer
+       * this is the new (odd) instruction
+       */
+
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t value = ( ( (uint64_t)phi[k] << 32 ) | plo[k] ) - borrow;
+          borrow         = ~(value >> 32) + 1;
+          un_j[s0 + k]   = (uint32_t)value;
+        }
+    }
 
-    t         = un[j + n] - k;
-    un[j + n] = (unsigned)t;
+  /* The last words, the top one included, a word at a time. */
+
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint32_t vn_i  = ii < n ? vn[ii] : 0;
+      uint64_t value = un_j[ii] - (uint64_t)qhat * vn_i;
+      plo[0]         = value & 0xffffffffLL;
+      phi[0]         = value >> 32;
+
+      value    = ( ( (uint64_t)phi[0] << 32 ) | plo[0] ) - borrow;
+      borrow   = ~(value >> 32) + 1;
+      un_j[ii] = (uint32_t)value;
+    }
 
-    bool need_fixup = t < 0;
+  return borrow != 0;
+}
 
 /****************************************************************************/
 
-#elif defined(SUB_MUL_BORROW)
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry_2stage_0 (uint32_t qhat, unsigned un_j[],
+                                unsigned vn[], int n);
 
-    (void)p;
-    (void)t;
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry_2stage_0 (uint32_t qhat, unsigned un_j[],
+                                unsigned vn[], int n)
+{
+  uint32_t carry = 1;
+  uint32_t phi[KD_DIV_STAGE];
+  uint32_t plo[KD_DIV_STAGE];
+  int s0;
 
-    uint32_t borrow = 0;
+  /* sv.msubx, elements independent, then the chained second stage. */
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint32_t vn_i  = ii < n ? vn[ii] : 0;
-        uint64_t value = un[ii + j] - (uint64_t)qhat * vn_i - borrow;
-        borrow         = -(uint32_t)(value >> 32);
-        un[ii + j]     = (uint32_t)value;
-      }
+  KD_DIV_SV_CALL (2);
+  KD_DIV_SV_VEC (n + 1, false);
+  KD_DIV_SV_VEC (n + 1, true);
+
+  for (s0 = 0; s0 + KD_DIV_STAGE <= n; s0 += KD_DIV_STAGE)
+    {
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t value = un_j[s0 + k] + ~( (uint64_t)qhat * vn[s0 + k] );
+          plo[k]         = value & 0xffffffffLL;
+          phi[k]         = value >> 32;
+        }
 
-    bool need_fixup = borrow != 0;
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t result = ( ( (uint64_t)phi[k] << 32 ) | plo[k] ) + carry;
 
-/****************************************************************************/
+          uint32_t result_high  = result >> 32;
 
-#elif defined(MUL_RSUB_CARRY)
+          if (carry <= 1)
+            result_high++;
 
-    (void)p;
-    (void)t;
+          carry        = result_high;
+          un_j[s0 + k] = (uint32_t)result;
+        }
+    }
 
-    uint32_t carry = 1;
+  /* The last words, the top one included, a word at a time. */
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint32_t vn_i   = ii < n ? vn[ii] : 0;
-        uint64_t result = un[ii + j] +
-                            ~( (uint64_t)qhat * vn_i ) +
-                            carry;
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint32_t vn_i  = ii < n ? vn[ii] : 0;
+      uint64_t value = un_j[ii] + ~( (uint64_t)qhat * vn_i );
+      plo[0]         = value & 0xffffffffLL;
+      phi[0]         = value >> 32;
 
-        uint32_t result_high = result >> 32;
+      uint64_t result = ( ( (uint64_t)phi[0] << 32 ) | plo[0] ) + carry;
 
-        if (carry <= 1)
-          result_high++;
+      uint32_t result_high  = result >> 32;
 
-        carry      = result_high;
-        un[ii + j] = (uint32_t)result;
-      }
+      if (carry <= 1)
+        result_high++;
 
-    bool need_fixup = carry != 1;
+      carry    = result_high;
+      un_j[ii] = (uint32_t)result;
+    }
+
+  return carry != 1;
+}
 
 /****************************************************************************/
 
-#elif defined(SUB_MUL_BORROW_2_STAGE)
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry_2stage_1 (uint32_t qhat, unsigned un_j[],
+                                unsigned vn[], int n);
 
-    (void)p;
-    (void)t;
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry_2stage_1 (uint32_t qhat, unsigned un_j[],
+                                unsigned vn[], int n)
+{
+  uint32_t carry = 1;
+  uint32_t phi[KD_DIV_STAGE];
+  uint32_t plo[KD_DIV_STAGE];
+  int s0;
 
-    uint32_t borrow = 0;
-    uint32_t phi[2000];
-    uint32_t plo[2000];
+  /* sv.msubx, elements independent, then the chained second stage. */
 
-    /*
-     * First, perform mul-and-sub and store in split hi-lo
-     * this shows the vectorised sv.msubx which stores 128-bit in
-     * two 64-bit registers
-     */
+  KD_DIV_SV_CALL (2);
+  KD_DIV_SV_VEC (n + 1, false);
+  KD_DIV_SV_VEC (n + 1, true);
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint32_t vn_i  = ii < n ? vn[ii] : 0;
-        uint64_t value = un[ii + j] - (uint64_t)qhat * vn_i;
-        plo[ii]        = value & 0xffffffffLL;
-        phi[ii]        = value >> 32;
-      }
+  for (s0 = 0; s0 + KD_DIV_STAGE <= n; s0 += KD_DIV_STAGE)
+    {
+      /*
+       * Same mul-and-sub as SUB_MUL_BORROW but not the same
+       * mul-and-sub-minus-one as MUL_RSUB_CARRY
+       */
 
-    /*
-     * Second, reconstruct the 64-bit result, subtract borrow,
-     * store top-half (-ve) in new borrow and store low-half as answer
-     * this is the new (odd) instruction
-     */
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t value = un_j[s0 + k] - ( (uint64_t)qhat * vn[s0 + k] );
+          plo[k]         = value & 0xffffffffLL;
+          phi[k]         = value >> 32;
+        }
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint64_t value = ( ( (uint64_t)phi[ii] << 32 ) |
-                           plo[ii] ) - borrow;
-        borrow         = ~(value >> 32) + 1;
-        un[ii + j]     = (uint32_t)value;
-      }
+      /*
+       * Compensate for the +1 that was added by mul-and-sub
+       * by subtracting it here ( as ~(0) ).
+       */
 
-    bool need_fixup = borrow != 0;
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t result = (uint64_t)( ( ( (uint64_t)phi[k] << 32 ) |
+                              (uint64_t)plo[k] ) +
+                              (unsigned long)carry +
+                              (unsigned long)( ~(0L) ) );  /* i.e. "-1" */
 
-/****************************************************************************/
+          uint32_t result_high = result >> 32;
 
-#elif defined(MUL_RSUB_CARRY_2_STAGE)
+          if (carry <= 1)
+            result_high++;
 
-    (void)p;
-    (void)t;
+          carry        = result_high;
+          un_j[s0 + k] = (uint32_t)result;
+        }
+    }
 
-    uint32_t carry = 1;
-    uint32_t phi[2000];
-    uint32_t plo[2000];
+  /* The last words, the top one included, a word at a time. */
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint32_t vn_i  = ii < n ? vn[ii] : 0;
-        uint64_t value = un[ii + j] + ~( (uint64_t)qhat * vn_i );
-        plo[ii]        = value & 0xffffffffLL;
-        phi[ii]        = value >> 32;
-      }
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint32_t vn_i  = ii < n ? vn[ii] : 0;
+      uint64_t value = un_j[ii] - ( (uint64_t)qhat * vn_i );
+      plo[0]         = value & 0xffffffffLL;
+      phi[0]         = value >> 32;
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint64_t result = ( ( (uint64_t)phi[ii] << 32 ) |
-                            plo[ii] ) +
-                            carry;
+      uint64_t result = (uint64_t)( ( ( (uint64_t)phi[0] << 32 ) |
+                          (uint64_t)plo[0] ) +
+                          (unsigned long)carry +
+                          (unsigned long)( ~(0L) ) );  /* i.e. "-1" */
 
-        uint32_t result_high  = result >> 32;
+      uint32_t result_high = result >> 32;
 
-        if (carry <= 1)
-          result_high++;
+      if (carry <= 1)
+        result_high++;
 
-        carry      = result_high;
-        un[ii + j] = (uint32_t)result;
-      }
+      carry    = result_high;
+      un_j[ii] = (uint32_t)result;
+    }
 
-    bool need_fixup = carry != 1;
+  return carry != 1;
+}
 
 /****************************************************************************/
 
-#elif defined(MUL_RSUB_CARRY_2_STAGE1)
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry_2stage_2 (uint32_t qhat, unsigned un_j[],
+                                unsigned vn[], int n);
 
-    (void)p;
-    (void)t;
+KD_DIV_LOCAL bool
+mulsub_mul_rsub_carry_2stage_2 (uint32_t qhat, unsigned un_j[],
+                                unsigned vn[], int n)
+{
+  uint32_t carry = 0;
+  uint32_t phi[KD_DIV_STAGE];
+  uint32_t plo[KD_DIV_STAGE];
+  int s0;
 
-    uint32_t carry = 1;
-    uint32_t phi[2000];
-    uint32_t plo[2000];
+  /* sv.msubx, elements independent, then the chained second stage. */
 
-    /*
-     * Same mul-and-sub as SUB_MUL_BORROW but not the same
-     * mul-and-sub-minus-one as MUL_RSUB_CARRY
-     */
+  KD_DIV_SV_CALL (2);
+  KD_DIV_SV_VEC (n + 1, false);
+  KD_DIV_SV_VEC (n + 1, true);
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint32_t vn_i  = ii < n ? vn[ii] : 0;
-        uint64_t value = un[ii + j] - ( (uint64_t)qhat * vn_i );
-        plo[ii]         = value & 0xffffffffLL;
-        phi[ii]         = value >> 32;
-      }
+  for (s0 = 0; s0 + KD_DIV_STAGE <= n; s0 += KD_DIV_STAGE)
+    {
+      /*
+       * Same mul-and-sub as SUB_MUL_BORROW but not the same
+       * mul-and-sub-minus-one as MUL_RSUB_CARRY
+       */
 
-    /*
-     * Compensate for the +1 that was added by mul-and-sub
-     * by subtracting it here ( as ~(0) ).
-     */
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t value = un_j[s0 + k] - ( (uint64_t)qhat * vn[s0 + k] );
+          plo[k]         = value & 0xffffffffLL;
+          phi[k]         = value >> 32;
+        }
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint64_t result = (uint64_t)( ( ( (uint64_t)phi[ii] << 32 ) |
-                            (uint64_t)plo[ii] ) +
-                            (unsigned long)carry +
-                            (unsigned long)( ~(0L) ) );  /* i.e. "-1" */
+      for (int k = 0; k < KD_DIV_STAGE; k++)
+        {
+          uint64_t result = ( ( (uint64_t)phi[k] << 32 ) | plo[k] ) + carry;
 
-        uint32_t result_high = result >> 32;
+          uint32_t result_high = result >> 32;
 
-        if (carry <= 1)
-          result_high++;
+          if (carry == 0)
+            carry = result_high;
+          else
+            carry = result_high - 1;
 
-        carry      = result_high;
-        un[ii + j] = (uint32_t)result;
-      }
+          un_j[s0 + k] = (uint32_t)result;
+        }
+    }
 
-    bool need_fixup = carry != 1;
+  /* The last words, the top one included, a word at a time. */
 
-/****************************************************************************/
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint32_t vn_i  = ii < n ? vn[ii] : 0;
+      uint64_t value = un_j[ii] - ( (uint64_t)qhat * vn_i );
+      plo[0]         = value & 0xffffffffLL;
+      phi[0]         = value >> 32;
 
-#elif defined(MUL_RSUB_CARRY_2_STAGE2)
+      uint64_t result = ( ( (uint64_t)phi[0] << 32 ) | plo[0] ) + carry;
 
-    (void)p;
-    (void)t;
+      uint32_t result_high = result >> 32;
 
-    uint32_t carry = 0;
-    uint32_t phi[2000];
-    uint32_t plo[2000];
+      if (carry == 0)
+        carry = result_high;
+      else
+        carry = result_high - 1;
 
-    /*
-     * Same mul-and-sub as SUB_MUL_BORROW but not the same
-     * mul-and-sub-minus-one as MUL_RSUB_CARRY
-     */
+      un_j[ii] = (uint32_t)result;
+    }
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint32_t vn_i  = ii < n ? vn[ii] : 0;
-        uint64_t value = un[ii + j] - ( (uint64_t)qhat * vn_i );
-        plo[ii]        = value & 0xffffffffLL;
-        phi[ii]        = value >> 32;
-      }
+  return carry != 0;
+}
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint64_t result = ( ( (uint64_t)phi[ii] << 32 ) |
-                            plo[ii] ) +
-                            carry;
+/****************************************************************************/
 
-        uint32_t result_high = result >> 32;
+KD_DIV_LOCAL bool
+mulsub_madded_subfe (uint32_t qhat, unsigned un_j[], unsigned vn[], int n);
 
-        if (carry == 0)
-          carry = result_high;
-        else
-          carry = result_high - 1;
+KD_DIV_LOCAL bool
+mulsub_madded_subfe (uint32_t qhat, unsigned un_j[], unsigned vn[], int n)
+{
+  uint32_t carry = 0;
+  uint32_t product[KD_DIV_STRIP];
+  bool ca = true;
 
-        un[ii + j] = (uint32_t)result;
-      }
+  /* sv.madded and sv.subfe, both chained. */
 
-    bool need_fixup = carry != 0;
+  KD_DIV_SV_CALL (2);
+  KD_DIV_SV_VEC (n + 1, true);
+  KD_DIV_SV_VEC (n + 1, true);
 
-/****************************************************************************/
+  for (int s0 = 0; s0 <= n; s0 += KD_DIV_STRIP)
+    {
+      int end = n + 1 - s0 < KD_DIV_STRIP ? n + 1 : s0 + KD_DIV_STRIP;
 
-#elif defined(MADDED_SUBFE)
+      /* VL = end - s0 */
+      /* sv.madded product.v, vn.v, qhat.s, carry.s */
 
-    (void)p;
-    (void)t;
+      for (int ii = s0; ii < end; ii++)
+        {
+          uint32_t vn_v    = ii < n ? vn[ii] : 0;
+          uint64_t value   = (uint64_t)vn_v * (uint64_t)qhat + carry;
+          carry            = (uint32_t)(value >> 32);
+          product[ii - s0] = (uint32_t)value;
+        }
 
-    uint32_t carry = 0;
-#ifdef __COMPCERT__
-    uint32_t product[1 + 65535 * 4];
-#else
-    uint32_t product[n + 1];
-#endif /* ifdef __COMPCERT__ */
+      /* VL = end - s0 */
+      /* sv.subfe un_j.v, product.v, un_j.v */
 
-    /* VL = n + 1 */
-    /* sv.madded product.v, vn.v, qhat.s, carry.s */
+      for (int ii = s0; ii < end; ii++)
+        {
+          uint64_t value = (uint64_t) ~product[ii - s0] +
+                             (uint64_t)un_j[ii] + ca;
+          ca             = value >> 32 != 0;
+          un_j[ii]       = (unsigned)value;
+        }
+    }
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint32_t vn_v  = ii < n ? vn[ii] : 0;
-        uint64_t value = (uint64_t)vn_v * (uint64_t)qhat + carry;
-        carry          = (uint32_t)(value >> 32);
-        product[ii]    = (uint32_t)value;
-      }
+  return !ca;
+}
 
-    bool ca = true;
+#endif /* if !defined(KD_DIV_LIBRARY) || defined(KD_DIV_TUNE) */
 
-    /* VL = n + 1 */
-    /* sv.subfe un_j.v, product.v, un_j.v */
+#ifdef KD_DIV_HAVE_ADX
 
-    for (int ii = 0; ii <= n; ii++)
-      {
-        uint64_t value = (uint64_t) ~product[ii] + (uint64_t)un_j[ii] + ca;
-        ca             = value >> 32 != 0;
-        un_j[ii]       = (unsigned)value;
-      }
+/****************************************************************************/
 
-    bool need_fixup = !ca;
+/*
+ * True if the processor has BMI2 (mulx) and ADX (adcx, adox).
+ */
 
-#else
+KD_DIV_LOCAL bool
+kd_div_cpu_adx (void);
 
-# error No algorithm selected!
+KD_DIV_LOCAL bool
+kd_div_cpu_adx (void)
+{
+  unsigned a, b, c, d;
 
-#endif
+  return __get_cpuid_count (7, 0, &a, &b, &c, &d) &&
+         (b & bit_BMI2) != 0 && (b & bit_ADX) != 0;
+}
 
 /****************************************************************************/
 
-    q[j] = (unsigned)qhat;  /* Store quotient digit. */
+/*
+ * Multiply-and-subtract with BMI2 and ADX.  un_j and vn are taken two
+ * words at a time as 64-bit limbs, four limbs to a block: mulx forms
+ * qhat * limb, adox chains the high half of each product into the low
+ * half of the next on OF, and adcx subtracts the result from un_j on CF
+ * by adding its complement, so the two carry chains run side by side.
+ * The carry out of a block, at most b, goes to the next in a register,
+ * and the last n % 8 words are done as in mulsub_original().  Only
+ * selected where kd_div_cpu_adx() says so.
+ */
 
-    if (need_fixup)
-      {                     /* If we subtracted too */
-        q[j] = q[j] - 1;    /* much, add it back.   */
+KD_DIV_LOCAL bool
+mulsub_mulx_adx (uint32_t qhat, unsigned un_j[], unsigned vn[], int n);
 
-        (void)bigadd (un_j, vn, un_j, m, n, 0);
-      }
+KD_DIV_LOCAL bool
+mulsub_mulx_adx (uint32_t qhat, unsigned un_j[], unsigned vn[], int n)
+{
+  unsigned long long p;                      /* Product of two digits.    */
+  uint64_t c = 0;                            /* Carry between blocks.     */
+  long long k, t;
+  int i;
 
-  }  /* End j. */
+  /* Scalar: 25 instructions a block of 8 words, 6 a word after. */
 
-  /*
-   * If the caller wants the remainder,
-   * unnormalize it and pass it back.
-   */
+  KD_DIV_SV_CALL (0);
+  KD_DIV_SV_SCALAR (25 * (n / 8) + 6 * (n % 8) + 3, n / 2 + n % 8 + 1);
 
-  if (r != NULL)
+  for (i = 0; i + 8 <= n; i += 8)
     {
-      for (i = 0; i < n - 1; i++)
-        r[i] = (unsigned int)( (un[i] >> s) |
-                 ( (unsigned long long)un[i + 1] << (32 - s) ) );
+      uint64_t lo, h0, h1, zero;
+
+      __asm__ ("xor    %k[zero], %k[zero]\n\t"    /* CF = OF = 0.  */
+               "stc\n\t"                          /* No borrow.    */
+               "mulx   0(%[v]), %[lo], %[h0]\n\t"
+               "adox   %[c], %[lo]\n\t"
+               "not    %[lo]\n\t"
+               "adcx   0(%[u]), %[lo]\n\t"
+               "mov    %[lo], 0(%[u])\n\t"
+               "mulx   8(%[v]), %[lo], %[h1]\n\t"
+               "adox   %[h0], %[lo]\n\t"
+               "not    %[lo]\n\t"
+               "adcx   8(%[u]), %[lo]\n\t"
+               "mov    %[lo], 8(%[u])\n\t"
+               "mulx   16(%[v]), %[lo], %[h0]\n\t"
+               "adox   %[h1], %[lo]\n\t"
+               "not    %[lo]\n\t"
+               "adcx   16(%[u]), %[lo]\n\t"
+               "mov    %[lo], 16(%[u])\n\t"
+               "mulx   24(%[v]), %[lo], %[h1]\n\t"
+               "adox   %[h0], %[lo]\n\t"
+               "not    %[lo]\n\t"
+               "adcx   24(%[u]), %[lo]\n\t"
+               "mov    %[lo], 24(%[u])\n\t"
+               "adox   %[zero], %[h1]\n\t"        /* Product carry. */
+               "cmc\n\t"                          /* CF = borrow.   */
+               "adc    %[zero], %[h1]"
+               : [lo] "=&r" (lo), [h0] "=&r" (h0), [h1] "=&r" (h1),
+                 [zero] "=&r" (zero)
+               : [c] "r" (c), [u] "r" (&un_j[i]), [v] "r" (&vn[i]),
+                 "d" ( (uint64_t)qhat )
+               : "cc", "memory");
+
+      c = h1;
+    }
 
-      r[n - 1] = un[n - 1] >> s;
+  k = (long long)c;
+
+  for (; i < n; i++)
+    {
+      p = qhat * (unsigned long long)vn[i];
+
+      t = (long long)( (long long)un_j[i] -
+             (long long)k -
+             (long long)(p & 0xFFFFFFFFLL) );
+
+      un_j[i] = (unsigned)t;
+
+      k  = (long long)( (long long)(p >> 32) -
+             (long long)(t >> 32) );
     }
 
-#ifdef __COMPCERT__
-  free(vn);
-  free(un);
-#endif /* ifdef __COMPCERT__ */
+  t       = un_j[n] - k;
+  un_j[n] = (unsigned)t;
 
-  return 0;
+  return t < 0;
 }
 
 /****************************************************************************/
 
-void
-check (unsigned q[], unsigned r[], unsigned u[], unsigned v[], int m, int n,
-       unsigned cq[], unsigned cr[], long l);
+/*
+ * bigmuladd() with BMI2 and ADX, in blocks of four 64-bit limbs as in
+ * mulsub_mulx_adx(): mulx forms a * limb, adox chains the high halves
+ * on OF and adcx adds the result into w on CF.  The carry out of a
+ * block is at most b, and the last n % 8 words are done as in
+ * bigmuladd().  Only selected where kd_div_cpu_adx() says so.
+ */
 
-void
-check (unsigned q[], unsigned r[], unsigned u[], unsigned v[], int m, int n,
-       unsigned cq[], unsigned cr[], long l)
-{
-  int i, szq;
+KD_DIV_LOCAL uint32_t
+bigmuladd_mulx_adx (uint32_t a, unsigned w[], unsigned b[], int n);
 
-  szq = kd_div_max (m - n + 1, 1);
+KD_DIV_LOCAL uint32_t
+bigmuladd_mulx_adx (uint32_t a, unsigned w[], unsigned b[], int n)
+{
+  uint64_t k = 0;                            /* Carry between blocks.     */
+  int i;
 
-  for (i = 0; i < szq; i++)
+  for (i = 0; i + 8 <= n; i += 8)
     {
-      if (q[i] != cq[i])
-        {
-          if (l == 1)
-            {
-              (void)fprintf (stderr, "\n\n");
-              dumpit ("FATAL ERROR: dividend u =", m, u);
-              dumpit ("             divisor  v =", n, v);
-              dumpit ("             remainder  =", m - n + 1, q);
-              dumpit ("             should be  =", m - n + 1, cq);
-              kd_div_errors++;
-            }
-
-          return;
-        }
+      uint64_t lo, h0, h1, zero;
+
+      __asm__ ("xor    %k[zero], %k[zero]\n\t"    /* CF = OF = 0.  */
+               "mulx   0(%[b]), %[lo], %[h0]\n\t"
+               "adox   %[k], %[lo]\n\t"
+               "adcx   0(%[w]), %[lo]\n\t"
+               "mov    %[lo], 0(%[w])\n\t"
+               "mulx   8(%[b]), %[lo], %[h1]\n\t"
+               "adox   %[h0], %[lo]\n\t"
+               "adcx   8(%[w]), %[lo]\n\t"
+               "mov    %[lo], 8(%[w])\n\t"
+               "mulx   16(%[b]), %[lo], %[h0]\n\t"
+               "adox   %[h1], %[lo]\n\t"
+               "adcx   16(%[w]), %[lo]\n\t"
+               "mov    %[lo], 16(%[w])\n\t"
+               "mulx   24(%[b]), %[lo], %[h1]\n\t"
+               "adox   %[h0], %[lo]\n\t"
+               "adcx   24(%[w]), %[lo]\n\t"
+               "mov    %[lo], 24(%[w])\n\t"
+               "adox   %[zero], %[h1]\n\t"        /* Product carry. */
+               "adcx   %[zero], %[h1]"            /* Sum carry.     */
+               : [lo] "=&r" (lo), [h0] "=&r" (h0), [h1] "=&r" (h1),
+                 [zero] "=&r" (zero)
+               : [k] "r" (k), [w] "r" (&w[i]), [b] "r" (&b[i]),
+                 "d" ( (uint64_t)a )
+               : "cc", "memory");
+
+      k = h1;
     }
 
-  for (i = 0; i < n; i++)
+  for (; i < n; i++)
     {
-      if (r[i] != cr[i])
-        {
-          if (l == 1)
-            {
-              (void)fprintf (stderr, "\n\n");
-              dumpit ("FATAL ERROR: dividend u =", m, u);
-              dumpit ("             divisor  v =", n, v);
-              dumpit ("             remainder  =", n, r);
-              dumpit ("             should be  =", n, cr);
-              kd_div_errors++;
-            }
-
-          return;
-        }
+      uint64_t t = (uint64_t)a * b[i] + w[i] + k;
+      w[i]       = (uint32_t)t;
+      k          = t >> 32;
     }
 
-  return;
+  return (uint32_t)k;
 }
 
+#endif /* ifdef KD_DIV_HAVE_ADX */
+
 /****************************************************************************/
 
-int
-divmnu_test (void);
+/*
+ * Kernel dispatch table.  The names match the suffixes of the old
+ * per-variant executables (divmnu-original, divmnu-madded_subfe, ...).
+ * usable, if not NULL, says whether the processor can run the kernel;
+ * where it cannot, kd_div_kernel_mulsub() falls back to the portable
+ * mulsub_original().
+ */
 
-int
-divmnu_test (void)
+typedef struct
 {
-  static struct
-  {
-    int m;
-    int n;
-    uint32_t  u[10];
-    uint32_t  v[10];
-    uint32_t cq[10];
-    uint32_t cr[10];
-    bool error;
-    char pad[3];
-  } test[] = {
+  const char      *name;
+  kd_div_mulsub_t  mulsub;
+  bool           (*usable) (void);
+} kd_div_kernel_t;
+
+#if !defined(KD_DIV_LIBRARY) || defined(KD_DIV_TUNE)
+
+KD_DIV_LOCAL const kd_div_kernel_t kd_div_kernels[] = {
+  { "original",                mulsub_original,                NULL },
+  { "sub_mul_borrow",          mulsub_sub_mul_borrow,          NULL },
+  { "mul_rsub_carry",          mulsub_mul_rsub_carry,          NULL },
+  { "sub_mul_borrow_2stage",   mulsub_sub_mul_borrow_2stage,   NULL },
+  { "mul_rsub_carry_2stage_0", mulsub_mul_rsub_carry_2stage_0, NULL },
+  { "mul_rsub_carry_2stage_1", mulsub_mul_rsub_carry_2stage_1, NULL },
+  { "mul_rsub_carry_2stage_2", mulsub_mul_rsub_carry_2stage_2, NULL },
+  { "madded_subfe",            mulsub_madded_subfe,            NULL },
+#ifdef KD_DIV_HAVE_ADX
+  { "mulx_adx",                mulsub_mulx_adx,      kd_div_cpu_adx },
+#else
+  { "mulx_adx",                mulsub_original,                NULL },
+#endif /* ifdef KD_DIV_HAVE_ADX */
+};
 
-    { .m     =   3  ,
-      .n     =   1  ,
-      .u     = { 3 },
-      .v     = { 0 },
-      .cq    = { 1 },
-      .cr    = { 1 },
-      .error = true
-    },
+KD_DIV_LOCAL const int kd_div_nkernels = sizeof (kd_div_kernels) /
+                                         sizeof (kd_div_kernels[0]);
 
-    { .m     =      1  ,
-      .n     =      2  ,
-      .u     = { 7    },
-      .v     = { 1, 3 },
-      .cq    = {    0 },
-      .cr    = { 7, 0 },
-      .error = true
-    },
+#endif /* if !defined(KD_DIV_LIBRARY) || defined(KD_DIV_TUNE) */
 
-    { .m     =      2  ,
-      .n     =      2  ,
-      .u     = { 0, 0 },
-      .v     = { 1, 0 },
-      .cq    = {    0 },
-      .cr    = { 0, 0 },
-      .error = true
-    },
+/* Kernel used by divmnu(); see kd_div_select() and kd_div_select_best(). */
 
-    { .m     =   1  ,
-      .n     =   1  ,
-      .u     = { 3 },
-      .v     = { 2 },
-      .cq    = { 1 },
-      .cr    = { 1 }
-    },
+KD_DIV_LOCAL kd_div_mulsub_t kd_div_mulsub = mulsub_original;
 
-    { .m     =   1  ,
-      .n     =   1  ,
-      .u     = { 3 },
-      .v     = { 3 },
-      .cq    = { 1 },
-      .cr    = { 0 }
-    },
+/* Row of bigmulmn() and bigmulhi(); see kd_div_select_best(). */
 
-    { .m     =   1  ,
-      .n     =   1  ,
-      .u     = { 3 },
-      .v     = { 4 },
-      .cq    = { 0 },
-      .cr    = { 3 }
-    },
+KD_DIV_LOCAL uint32_t (*kd_div_muladd) (uint32_t a, unsigned w[],
+                                        unsigned b[], int n) =
+  bigmuladd;
 
-    { .m     =            1  ,
-      .n     =            1  ,
-      .u     = {          0 },
-      .v     = { 0xffffffff },
-      .cq    = {          0 },
-      .cr    = {          0 }
-    },
+/****************************************************************************/
 
-    { .m     =            1  ,
-      .n     =            1  ,
-      .u     = { 0xffffffff },
-      .v     = {          1 },
-      .cq    = { 0xffffffff },
-      .cr    = {          0 }
-    },
+#if !defined(KD_DIV_LIBRARY) || defined(KD_DIV_TUNE)
 
-    { .m     =            1  ,
-      .n     =            1  ,
-      .u     = { 0xffffffff },
-      .v     = { 0xffffffff },
-      .cq    = {          1 },
+/*
+ * The multiply-and-subtract function to run for kernel: its own, or
+ * mulsub_original() if the processor cannot run it.
+ */
+
+KD_DIV_LOCAL kd_div_mulsub_t
+kd_div_kernel_mulsub (const kd_div_kernel_t *kernel);
+
+KD_DIV_LOCAL kd_div_mulsub_t
+kd_div_kernel_mulsub (const kd_div_kernel_t *kernel)
+{
+  if (kernel->usable != NULL && !kernel->usable ())
+    return mulsub_original;
+
+  return kernel->mulsub;
+}
+
+#endif /* if !defined(KD_DIV_LIBRARY) || defined(KD_DIV_TUNE) */
+
+/****************************************************************************/
+
+#ifndef KD_DIV_LIBRARY
+
+KD_DIV_LOCAL const kd_div_kernel_t *
+kd_div_find (const char *name);
+
+KD_DIV_LOCAL const kd_div_kernel_t *
+kd_div_find (const char *name)
+{
+  for (int i = 0; i < kd_div_nkernels; i++)
+    if (strcmp (kd_div_kernels[i].name, name) == 0)
+      return &kd_div_kernels[i];
+
+  return NULL;
+}
+
+/****************************************************************************/
+
+/*
+ * Select the kernel used by divmnu() by name.  Returns 0 for success
+ * and 1 if there is no kernel of that name, in which case the current
+ * selection is left unchanged.
+ */
+
+KD_DIV_LOCAL int
+kd_div_select (const char *name);
+
+KD_DIV_LOCAL int
+kd_div_select (const char *name)
+{
+  const kd_div_kernel_t *kernel = kd_div_find (name);
+
+  if (kernel == NULL)
+    return 1;
+
+  kd_div_mulsub = kd_div_kernel_mulsub (kernel);
+
+  return 0;
+}
+
+#endif /* ifndef KD_DIV_LIBRARY */
+
+/****************************************************************************/
+
+/*
+ * Quotient digit estimation.  KD_DIV_QHAT_HWDIV divides the top two
+ * digits of the partial remainder by vn[n-1] with a hardware divide,
+ * KD_DIV_QHAT_RECIPROCAL computes reciprocal_word(vn[n-1]) once per
+ * call and uses divrem_64_by_32_preinv() for every digit instead.
+ * Both are then refined against vn[n-2] in a loop.  KD_DIV_QHAT_3BY2
+ * divides the top three digits by the top two of vn with
+ * divrem_96_by_64_preinv() and reciprocal_3by2(), which needs no
+ * refinement loop.
+ */
+
+typedef enum
+{
+  KD_DIV_QHAT_HWDIV,
+  KD_DIV_QHAT_RECIPROCAL,
+  KD_DIV_QHAT_3BY2
+} kd_div_qhat_t;
+
+#ifndef KD_DIV_LIBRARY
+
+KD_DIV_LOCAL const char *const kd_div_qhat_names[] = {
+  [KD_DIV_QHAT_HWDIV]      = "hwdiv",
+  [KD_DIV_QHAT_RECIPROCAL] = "reciprocal",
+  [KD_DIV_QHAT_3BY2]       = "3by2",
+};
+
+KD_DIV_LOCAL const int kd_div_nqhats = sizeof (kd_div_qhat_names) /
+                                       sizeof (kd_div_qhat_names[0]);
+
+#endif /* ifndef KD_DIV_LIBRARY */
+
+/* Estimation used by divmnu(); see kd_div_select_qhat(). */
+
+KD_DIV_LOCAL kd_div_qhat_t kd_div_qhat = KD_DIV_QHAT_HWDIV;
+
+/****************************************************************************/
+
+#ifndef KD_DIV_LIBRARY
+
+/*
+ * Select the quotient digit estimation used by divmnu() by name.
+ * Returns 0 for success and 1 if there is no estimation of that name.
+ */
+
+KD_DIV_LOCAL int
+kd_div_select_qhat (const char *name);
+
+KD_DIV_LOCAL int
+kd_div_select_qhat (const char *name)
+{
+  for (int i = 0; i < kd_div_nqhats; i++)
+    if (strcmp (kd_div_qhat_names[i], name) == 0)
+      {
+        kd_div_qhat = (kd_div_qhat_t)i;
+
+        return 0;
+      }
+
+  return 1;
+}
+
+#endif /* ifndef KD_DIV_LIBRARY */
+
+/****************************************************************************/
+
+/*
+ * Tuned dispatch.  Built with -DKD_DIV_TUNE, divmnu_tune.h (written by
+ * "make tune", see divmnu_bench_tune()) gives in KD_DIV_TUNE_TABLE the
+ * kernel and quotient digit estimation that were fastest on the host
+ * for divisors of up to maxn words, by increasing maxn, the last entry
+ * also taking all longer divisors.  While kd_div_tuned is set (from the
+ * start, and by the "tuned" spec), divmnu(), divmnu_with_scratch() and
+ * divmnu_in_place() use them instead of kd_div_mulsub and kd_div_qhat,
+ * and divmnu_prepare() (so also divmnu_stream_open()) stores them in the
+ * context for divmnu_with_ctx() and the streaming division; finding the
+ * entry is a few comparisons, with nothing measured at run time.  The
+ * header also sets the algorithm crossovers (KD_DIV_*_THRESHOLD), and
+ * divmnu() sends divisors from KD_DIV_BZ_THRESHOLD words on to
+ * divmnu_auto().
+ */
+
+typedef struct
+{
+  int             maxn;                      /* Longest divisor, words.   */
+  kd_div_qhat_t   qhat;
+  kd_div_mulsub_t mulsub;
+} kd_div_tune_t;
+
+#ifdef KD_DIV_TUNE
+
+KD_DIV_LOCAL kd_div_tune_t kd_div_tune[] = { KD_DIV_TUNE_TABLE };
+
+KD_DIV_LOCAL const int kd_div_ntunes = sizeof (kd_div_tune) /
+                                       sizeof (kd_div_tune[0]);
+
+KD_DIV_LOCAL bool kd_div_tuned = true;
+
+/****************************************************************************/
+
+static inline const kd_div_tune_t *
+kd_div_tune_find (int n);
+
+static inline const kd_div_tune_t *
+kd_div_tune_find (int n)
+{
+  int t = 0;
+
+  while (t < kd_div_ntunes - 1 && n > kd_div_tune[t].maxn)
+    t++;
+
+  return &kd_div_tune[t];
+}
+
+#endif /* ifdef KD_DIV_TUNE */
+
+/****************************************************************************/
+
+/*
+ * Select the fastest kernel the processor can run for divmnu(), which
+ * otherwise uses mulsub_original(), and replace any kernel of
+ * kd_div_tune[] that it cannot run by mulsub_original().  main() calls
+ * it first; in the library, it runs when the library is loaded.
+ */
+
+#if defined(KD_DIV_LIBRARY) && defined(__GNUC__) && !defined(__COMPCERT__)
+__attribute__ ( (constructor) )
+#endif /* if defined(KD_DIV_LIBRARY) && defined(__GNUC__) && ... */
+KD_DIV_LOCAL void
+kd_div_select_best (void);
+
+KD_DIV_LOCAL void
+kd_div_select_best (void)
+{
+#ifdef KD_DIV_HAVE_ADX
+  if (kd_div_cpu_adx ())
+    {
+      kd_div_mulsub = mulsub_mulx_adx;
+      kd_div_muladd = bigmuladd_mulx_adx;
+    }
+#endif /* ifdef KD_DIV_HAVE_ADX */
+
+#ifdef KD_DIV_TUNE
+  for (int t = 0; t < kd_div_ntunes; t++)
+    for (int i = 0; i < kd_div_nkernels; i++)
+      if (kd_div_kernels[i].mulsub == kd_div_tune[t].mulsub)
+        kd_div_tune[t].mulsub = kd_div_kernel_mulsub (&kd_div_kernels[i]);
+#endif /* ifdef KD_DIV_TUNE */
+}
+
+/****************************************************************************/
+
+/*
+ * Fill in ctx for the divisor v, n words, normalizing it into vn (n
+ * words, supplied by the caller), with the current kd_div_qhat and
+ * kd_div_mulsub.  vn may be v itself if the top bit of v is already
+ * set, in which case nothing is copied.  The reciprocals are only
+ * computed if want_inv is set.  The parameters must already
+ * have been validated.
+ */
+
+KD_DIV_LOCAL void
+kd_div_setup (divmnu_ctx_t *ctx, unsigned vn[], const unsigned v[], int n,
+              bool want_inv);
+
+KD_DIV_LOCAL void
+kd_div_setup (divmnu_ctx_t *ctx, unsigned vn[], const unsigned v[], int n,
+              bool want_inv)
+{
+  int s, i;
+
+  /*
+   * Normalize by shifting v left just enough so that its high-order
+   * bit is on.
+   */
+
+  s  = nlz (v[n - 1]);  /* 0 <= s <= 31. */
+
+  if (vn != v)
+    {
+      for (i = n - 1; i > 0; i--)
+        vn[i] = (unsigned int)( (v[i] << s) |
+                  ( (unsigned long long)v[i - 1] >> (32 - s) ) );
+
+      vn[0] = v[0] << s;
+    }
+
+  ctx->n      = n;
+  ctx->s      = s;
+  ctx->vn     = vn;
+  ctx->vinv   = want_inv ? reciprocal_word (vn[n - 1]) : 0;
+  ctx->vinv3  = want_inv && n >= 2 ? reciprocal_3by2 (vn[n - 1], vn[n - 2])
+                                   : 0;
+  ctx->mulsub = kd_div_mulsub;
+  ctx->qhat   = kd_div_qhat;
+  ctx->owned  = false;
+}
+
+/****************************************************************************/
+
+/*
+ * Short division of u, m words, by the single word d.
+ */
+
+KD_DIV_LOCAL void
+divmnu_1 (unsigned q[], unsigned r[], const unsigned u[], int m,
+          uint32_t d);
+
+KD_DIV_LOCAL void
+divmnu_1 (unsigned q[], unsigned r[], const unsigned u[], int m,
+          uint32_t d)
+{
+  long long k = 0;
+
+  for (int j = m - 1; j >= 0; j--)
+    {
+      uint64_t dig2 = ( (uint64_t)k << 32 ) | u[j];
+      q[j]          = (unsigned int)(dig2 / d);
+      k             = dig2 % d;
+    }
+
+  if (r != NULL)
+    r[0] = (unsigned)k;
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu_1(), for the divisor d = dn >> s given normalized, as
+ * dn with dinv = reciprocal_word(dn): u is shifted left by s a word at
+ * a time as it is read, and each quotient digit comes from
+ * divrem_64_by_32_preinv() instead of a hardware divide.
+ */
+
+KD_DIV_LOCAL void
+divmnu_1_preinv (unsigned q[], unsigned r[], const unsigned u[], int m,
+                 uint32_t dn, int s, uint32_t dinv);
+
+KD_DIV_LOCAL void
+divmnu_1_preinv (unsigned q[], unsigned r[], const unsigned u[], int m,
+                 uint32_t dn, int s, uint32_t dinv)
+{
+  uint32_t k = (uint32_t)( (uint64_t)u[m - 1] >> (32 - s) );
+
+  for (int j = m - 1; j >= 0; j--)
+    {
+      uint32_t uj = (uint32_t)( (u[j] << s) |
+                      ( (uint64_t)(j > 0 ? u[j - 1] : 0) >> (32 - s) ) );
+
+      /* divrem_64_by_32_preinv(), which cannot overflow here as k < dn. */
+
+      uint64_t qq   = (uint64_t)dinv * k + ( ( (uint64_t)k << 32 ) | uj );
+      uint32_t q1   = (uint32_t)(qq >> 32) + 1;
+      uint32_t rr   = uj - q1 * dn;
+      uint32_t mask = -(uint32_t)(rr > (uint32_t)qq);
+
+      q1 = q1 + mask;
+      rr = rr + (mask & dn);
+
+      if (rr >= dn)
+        {
+          q1 = q1 + 1;
+          rr = rr - dn;
+        }
+
+      q[j] = q1;
+      k    = rr;
+    }
+
+  if (r != NULL)
+    r[0] = k >> s;
+}
+
+/****************************************************************************/
+
+/*
+ * Dividend length, in words, from which divmnu() divides by a one-word
+ * divisor with divmnu_1_preinv() rather than divmnu_1(): below it the
+ * reciprocal costs more than the hardware divides it saves.  "divmnu
+ * -b short" shows the crossover on a given machine, and "make tune"
+ * sets it.
+ */
+
+#ifndef KD_DIV_PREINV1_THRESHOLD
+# define KD_DIV_PREINV1_THRESHOLD 64
+#endif /* ifndef KD_DIV_PREINV1_THRESHOLD */
+
+KD_DIV_LOCAL int kd_div_preinv1_threshold = KD_DIV_PREINV1_THRESHOLD;
+
+/****************************************************************************/
+
+/*
+ * Division of u, m >= 2 words, by the two-word divisor (d1 * b + d0) >>
+ * s, given normalized, with dinv = reciprocal_3by2(d1, d0).  The
+ * divisor and the running remainder stay in registers: each quotient
+ * digit is one divrem_96_by_64_preinv() of the remainder and the next
+ * word of u, shifted left by s as it is read, so no normalized copies
+ * of u or v are made.
+ */
+
+KD_DIV_LOCAL void
+divmnu_2 (unsigned q[], unsigned r[], const unsigned u[], int m,
+          uint32_t d1, uint32_t d0, int s, uint32_t dinv);
+
+KD_DIV_LOCAL void
+divmnu_2 (unsigned q[], unsigned r[], const unsigned u[], int m,
+          uint32_t d1, uint32_t d0, int s, uint32_t dinv)
+{
+  const uint64_t d = ( (uint64_t)d1 << 32 ) | d0;
+
+  /* The top two words of u << s, which are below d. */
+
+  uint64_t rr = ( (uint64_t)u[m - 1] << s ) |
+                  ( (uint64_t)u[m - 2] >> (32 - s) );
+
+  for (int j = m - 3; j >= -1; j--)
+    {
+      uint32_t uj = j >= 0 ? (uint32_t)( (u[j + 1] << s) |
+                                 ( (uint64_t)u[j] >> (32 - s) ) )
+                           : u[0] << s;
+
+      q[j + 1] = divrem_96_by_64_preinv ( (uint32_t)(rr >> 32),
+                                          (uint32_t)rr, uj, d, dinv, &rr );
+    }
+
+  if (r != NULL)
+    {
+      rr   = rr >> s;
+      r[0] = (uint32_t)rr;
+      r[1] = (uint32_t)(rr >> 32);
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * One step of Algorithm D: the quotient digit of un_j[0..n] divided by
+ * the divisor described by ctx, where un_j[1..n] is less than the
+ * normalized divisor.  un_j is left holding the remainder in its low
+ * n words.  Shared by divmnu_core() and the streaming division, and
+ * inline because it is the whole of the inner loop of both.
+ */
+
+static inline uint32_t
+kd_div_digit (unsigned un_j[], const divmnu_ctx_t *ctx,
+              kd_div_qhat_t qhat_mode, kd_div_mulsub_t mulsub)
+{
+  const unsigned long long  b = 1LL << 32;   /* Number base (2**32).      */
+  const int n    = ctx->n;
+  unsigned *vn   = ctx->vn;                  /* Normalized form of v.     */
+  uint32_t  vinv = ctx->vinv;                /* Reciprocal of vn[n-1].    */
+  uint32_t vinv3 = ctx->vinv3;               /* Same, of vn[n-1..n-2].    */
+  unsigned long long qhat;                   /* Estimated quotient digit. */
+  unsigned long long rhat;                   /* A remainder.              */
+#ifdef KD_DIV_STATS
+  const unsigned long adjusted = kd_div_stats.adjust;
+#endif /* ifdef KD_DIV_STATS */
+
+  KD_DIV_COUNT (digits);
+
+  if (qhat_mode == KD_DIV_QHAT_3BY2)
+    {
+
+      /*
+       * Compute qhat from the top 3 digits and the top 2 digits of
+       * vn.  They can only be equal to vn's when the digit is b - 1.
+       */
+
+      uint64_t vtop = ( (uint64_t)vn[n - 1] << 32 ) | vn[n - 2];
+      uint64_t rtop;
+
+      if (un_j[n] == vn[n - 1] && un_j[n - 1] == vn[n - 2])
+        {
+          qhat = b - 1;
+          KD_DIV_COUNT (overflows);
+        }
+      else
+        qhat = divrem_96_by_64_preinv (un_j[n], un_j[n - 1],
+                                       un_j[n - 2], vtop, vinv3, &rtop);
+    }
+  else
+    {
+
+      /* Compute estimate qhat of the digit from top 2 digits. */
+
+      uint64_t dig2  = ( (uint64_t)un_j[n] << 32 ) | un_j[n - 1];
+      divrem_t qr    = qhat_mode == KD_DIV_QHAT_RECIPROCAL
+                         ? divrem_64_by_32_preinv (dig2, vn[n - 1], vinv)
+                         : divrem_64_by_32 (dig2, vn[n - 1]);
+      qhat           = qr.q;
+      rhat           = qr.r;
+
+      if (qr.overflow)
+        {
+          KD_DIV_COUNT (overflows);
+
+          /*
+           * rhat can be bigger than 32-bit when the division overflows;
+           * thus rhat computation cannot be folded into divrem_64_by_32
+           */
+
+          rhat = dig2 - (uint64_t)qr.q * vn[n - 1];
+        }
+
+  again:
+
+      /* Use 3rd-from-top digit to obtain better accuracy */
+
+      if (rhat < b &&
+       (unsigned)qhat * (unsigned long long)vn[n - 2] >
+       b * rhat + un_j[n - 2])
+        {
+          qhat = qhat - 1;
+          rhat = rhat + vn[n - 1];
+
+          KD_DIV_COUNT (adjust);
+
+          if (rhat < b)
+            goto again;
+      }
+    }
+
+  KD_DIV_HIST (corrections, kd_div_stats.adjust - adjusted);
+
+  /* Multiply and subtract. */
+
+  bool need_fixup = mulsub ( (uint32_t)qhat, un_j, vn, n );
+
+  if (need_fixup)
+    {                     /* If we subtracted too */
+      qhat = qhat - 1;    /* much, add it back.   */
+
+      KD_DIV_COUNT (fixups);
+      KD_DIV_SV_VEC (n, true);               /* sv.adde                   */
+
+      /*
+       * vn has only n digits; the carry out of the top one just
+       * cancels the borrow in un_j[n], which is not used again.
+       */
+
+      (void)bigadd (un_j, vn, un_j, n, n - 1, 0);
+    }
+
+  return (uint32_t)qhat;
+}
+
+/****************************************************************************/
+
+/*
+ * The dividend half of divmnu(): divide u, m words, by the divisor
+ * described by ctx, with ctx->n >= 2 and m >= ctx->n.  un is scratch
+ * space of m + 1 words for the normalized dividend.  If un is u itself
+ * (which then needs room for m + 1 words), u is normalized in place,
+ * a word at a time as the quotient digits that first use it come up,
+ * and is left holding the normalized remainder in its low n words.
+ */
+
+KD_DIV_LOCAL void
+divmnu_core (unsigned q[], unsigned r[], const unsigned u[], int m,
+             const divmnu_ctx_t *ctx,
+             kd_div_qhat_t qhat_mode, kd_div_mulsub_t mulsub,
+             unsigned un[]);
+
+KD_DIV_LOCAL void
+divmnu_core (unsigned q[], unsigned r[], const unsigned u[], int m,
+             const divmnu_ctx_t *ctx,
+             kd_div_qhat_t qhat_mode, kd_div_mulsub_t mulsub,
+             unsigned un[])
+{
+  const int n    = ctx->n;
+  const int s    = ctx->s;
+  int i, j;
+
+  /*
+   * Shift u left by the same amount as v. We may have to append a
+   * high-order digit on the dividend; we do that unconditionally.
+   * In place, only the top n words are shifted here, and the rest
+   * just before the quotient digit that first uses them.
+   */
+
+  const bool in_place = un == u;
+  const int  low      = in_place ? m - n + 1 : 1;
+
+  KD_DIV_COUNT (calls);
+  KD_DIV_HIST (shift, (unsigned)s);
+
+  un[m] = s == 0 ? 0 : u[m - 1] >> (32 - s);
+
+  if (s == 0 && !in_place)
+    (void)memcpy (un, u, sizeof (unsigned) * (size_t)m);
+  else if (s != 0)
+    {
+      for (i = m - 1; i >= low; i--)
+        un[i] = (unsigned int)( (u[i] << s) |
+                  ( (unsigned long long)u[i - 1] >> (32 - s) ) );
+
+      if (!in_place)
+        un[0] = u[0] << s;
+    }
+
+  for (j = m - n; j >= 0; j--)
+    {
+
+    if (in_place && s != 0)
+      un[j] = j == 0 ? u[0] << s
+                     : (unsigned int)( (u[j] << s) |
+                         ( (unsigned long long)u[j - 1] >> (32 - s) ) );
+
+    q[j] = kd_div_digit (&un[j], ctx, qhat_mode, mulsub);
+  }  /* End j. */
+
+  /*
+   * If the caller wants the remainder,
+   * unnormalize it and pass it back.
+   */
+
+  if (r != NULL && s == 0)
+    {
+      if (r != un)
+        (void)memcpy (r, un, sizeof (unsigned) * (size_t)n);
+    }
+  else if (r != NULL)
+    {
+      for (i = 0; i < n - 1; i++)
+        r[i] = (unsigned int)( (un[i] >> s) |
+                 ( (unsigned long long)un[i + 1] << (32 - s) ) );
+
+      r[n - 1] = un[n - 1] >> s;
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * q[0], r[0], u[0], and v[0] contain the LEAST significant words.
+ * (The sequence is in little-endian order).
+ *
+ * This is a fairly precise implementation of Knuth's Algorithm D, for a
+ * binary computer with base b = 2**32. The caller supplies:
+ *
+ *   1. Space q for the quotient, m - n + 1 words (at least one).
+ *   2. Space r for the remainder (optional), n words.
+ *   3. The dividend u, m words, m >= 1.
+ *   4. The divisor v, n words, n >= 2.
+ *
+ * The most significant digit of the divisor, v[n-1], must be nonzero.
+ * The dividend u may have leading zeros; this just makes the algorithm
+ * take longer and makes the quotient contain more leading zeros.
+ * A value of NULL may be given for the address of the remainder to
+ * signify that the caller does not want the remainder.
+ *
+ *  * The program does not alter the input parameters u and v.
+ *
+ *  * The quotient and remainder returned may have leading zeros.  The
+ *    function itself returns a value of 0 for success and 1 for invalid
+ *    parameters (e.g., division by 0).
+ *
+ *  * For now, we must have m >= n.  Knuth's Algorithm D also requires
+ *    that the dividend be at least as long as the divisor.
+ *    (In his terms: "m >= 0 (unstated), therefore, m+n >= n." )
+ *
+ *  * The quotient digits are estimated as selected by qhat_mode, and
+ *    the multiply-and-subtract step is done by the given kernel;
+ *    divmnu() uses the ones chosen by kd_div_select_qhat() and
+ *    kd_div_select().
+ *
+ *  * ws is scratch space of divmnu_scratch_words(m, n) words, owned by
+ *    the caller; nothing else is allocated, on the heap or the stack.
+ */
+
+KD_DIV_LOCAL int
+divmnu_with_kernel (unsigned q[], unsigned r[], const unsigned u[],
+                    const unsigned v[], int m, int n,
+                    kd_div_qhat_t qhat_mode, kd_div_mulsub_t mulsub,
+                    unsigned ws[]);
+
+KD_DIV_LOCAL int
+divmnu_with_kernel (unsigned q[], unsigned r[], const unsigned u[],
+                    const unsigned v[], int m, int n,
+                    kd_div_qhat_t qhat_mode, kd_div_mulsub_t mulsub,
+                    unsigned ws[])
+{
+  divmnu_ctx_t ctx;
+
+  if (m < n || n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  if (n == 1 && m < kd_div_preinv1_threshold)
+    {
+      divmnu_1 (q, r, u, m, v[0]);
+
+      return 0;
+    }
+
+  if (n == 1)
+    {
+      const int s1 = nlz (v[0]);
+      uint32_t d   = v[0] << s1;
+
+      divmnu_1_preinv (q, r, u, m, d, s1, reciprocal_word (d));
+
+      return 0;
+    }
+
+  if (n == 2)
+    {
+      const int s2 = nlz (v[1]);
+      uint32_t d1  = (uint32_t)( (v[1] << s2) |
+                       ( (uint64_t)v[0] >> (32 - s2) ) );
+      uint32_t d0  = v[0] << s2;
+
+      divmnu_2 (q, r, u, m, d1, d0, s2, reciprocal_3by2 (d1, d0));
+
+      return 0;
+    }
+
+  kd_div_setup (&ctx, ws, v, n, qhat_mode != KD_DIV_QHAT_HWDIV);
+
+  divmnu_core (q, r, u, m, &ctx, qhat_mode, mulsub, &ws[n]);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Words of scratch space needed to divide m words by n words with
+ * divmnu_with_scratch(), or by a divisor context of n words with
+ * divmnu_with_ctx_scratch(): n for the normalized divisor and m + 1
+ * for the normalized dividend.  The one- and two-word divisor paths
+ * use none of it, but are given the same size so that a workspace can
+ * be sized from the largest operands alone.
+ */
+
+long
+divmnu_scratch_words (int m, int n);
+
+long
+divmnu_scratch_words (int m, int n)
+{
+  return (long)m + n + 1;
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu(), with the scratch space supplied by the caller: ws
+ * has divmnu_scratch_words(m, n) words, and may be reused from one call
+ * to the next.
+ */
+
+int
+divmnu_with_scratch (unsigned q[], unsigned r[], const unsigned u[],
+                     const unsigned v[], int m, int n, unsigned ws[]);
+
+int
+divmnu_with_scratch (unsigned q[], unsigned r[], const unsigned u[],
+                     const unsigned v[], int m, int n, unsigned ws[])
+{
+#ifdef KD_DIV_TUNE
+  if (kd_div_tuned)
+    {
+      const kd_div_tune_t *tune = kd_div_tune_find (n);
+
+      return divmnu_with_kernel (q, r, u, v, m, n, tune->qhat, tune->mulsub,
+                                 ws);
+    }
+#endif /* ifdef KD_DIV_TUNE */
+
+  return divmnu_with_kernel (q, r, u, v, m, n, kd_div_qhat, kd_div_mulsub,
+                             ws);
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu_with_scratch(), but dividing u in place instead of a
+ * normalized copy of it, for dividends too big to copy.  u must have
+ * room for m + 1 words, and is overwritten; r may be u, leaving the
+ * remainder in its low n words, but q must not overlap it.  ws needs
+ * only n words, and none at all if the top bit of v[n-1] is set, when
+ * the divisor is used as it is and nothing is shifted.
+ */
+
+int
+divmnu_in_place (unsigned q[], unsigned r[], unsigned u[],
+                 const unsigned v[], int m, int n, unsigned ws[]);
+
+int
+divmnu_in_place (unsigned q[], unsigned r[], unsigned u[],
+                 const unsigned v[], int m, int n, unsigned ws[])
+{
+  divmnu_ctx_t ctx;
+
+  if (m < n || n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  if (n <= 2)
+    return divmnu_with_scratch (q, r, u, v, m, n, ws);
+
+  kd_div_qhat_t qhat     = kd_div_qhat;
+  kd_div_mulsub_t mulsub = kd_div_mulsub;
+
+#ifdef KD_DIV_TUNE
+  if (kd_div_tuned)
+    {
+      const kd_div_tune_t *tune = kd_div_tune_find (n);
+
+      qhat   = tune->qhat;
+      mulsub = tune->mulsub;
+    }
+#endif /* ifdef KD_DIV_TUNE */
+
+  kd_div_setup (&ctx, v[n - 1] >> 31 ? (unsigned *)v : ws, v, n,
+                qhat != KD_DIV_QHAT_HWDIV);
+
+  divmnu_core (q, r, u, m, &ctx, qhat, mulsub, u);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * divmnu() by Algorithm D whatever the size, for the subquadratic
+ * algorithms, which hand their short divisions over to it.
+ */
+
+KD_DIV_LOCAL int
+kd_div_knuth (unsigned q[], unsigned r[], const unsigned u[],
+              const unsigned v[], int m, int n);
+
+KD_DIV_LOCAL int
+kd_div_knuth (unsigned q[], unsigned r[], const unsigned u[],
+              const unsigned v[], int m, int n)
+{
+  unsigned *ws;
+  int rc;
+
+  if (m < n || n <= 0)
+    return 1;                                /* Return if invalid param. */
+
+#ifdef __COMPCERT__
+  ws = malloc (sizeof (unsigned) * (size_t)divmnu_scratch_words (m, n));
+
+  if (ws == NULL)
+    return 2;
+#else
+  ws = (unsigned *)alloca (4 * (size_t)divmnu_scratch_words (m, n));
+#endif /* ifdef __COMPCERT__ */
+
+  rc = divmnu_with_scratch (q, r, u, v, m, n, ws);
+
+#ifdef __COMPCERT__
+  free (ws);
+#endif /* ifdef __COMPCERT__ */
+
+  return rc;
+}
+
+/****************************************************************************/
+
+/*
+ * Built with -DKD_DIV_TUNE, while kd_div_tuned is set, divisors of
+ * KD_DIV_BZ_THRESHOLD words or more go to divmnu_auto(), at the
+ * crossovers "make tune" found.
+ */
+
+int
+divmnu (unsigned q[], unsigned r[], const unsigned u[], const unsigned v[],
+        int m, int n);
+
+int
+divmnu (unsigned q[], unsigned r[], const unsigned u[], const unsigned v[],
+        int m, int n)
+{
+#ifdef KD_DIV_TUNE
+  if (kd_div_tuned && n >= KD_DIV_BZ_THRESHOLD && m >= n)
+    return divmnu_auto (q, r, u, v, m, n);
+#endif /* ifdef KD_DIV_TUNE */
+
+  return kd_div_knuth (q, r, u, v, m, n);
+}
+
+/****************************************************************************/
+
+/*
+ * Prepare ctx for repeated division by the divisor v, n words, with the
+ * same requirements on v and n as divmnu().  The normalized divisor is
+ * allocated and owned by ctx until divmnu_release().  The kernel and
+ * quotient digit estimation, tuned for n if kd_div_tuned is set, are
+ * chosen here once.  Returns 0 for success, 1 for invalid parameters
+ * and 2 if out of memory.
+ */
+
+int
+divmnu_prepare (divmnu_ctx_t *ctx, const unsigned v[], int n);
+
+int
+divmnu_prepare (divmnu_ctx_t *ctx, const unsigned v[], int n)
+{
+  unsigned *vn;
+
+  if (n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  vn = malloc (sizeof (unsigned) * (size_t)n);
+
+  if (vn == NULL)
+    return 2;
+
+  kd_div_setup (ctx, vn, v, n, true);
+
+  ctx->owned = true;
+
+#ifdef KD_DIV_TUNE
+  if (kd_div_tuned)
+    {
+      const kd_div_tune_t *tune = kd_div_tune_find (n);
+
+      ctx->qhat   = tune->qhat;
+      ctx->mulsub = tune->mulsub;
+    }
+#endif /* ifdef KD_DIV_TUNE */
+
+  return 0;
+}
+
+/****************************************************************************/
+
+void
+divmnu_release (divmnu_ctx_t *ctx);
+
+void
+divmnu_release (divmnu_ctx_t *ctx)
+{
+  if (ctx->owned)
+    free (ctx->vn);
+
+  ctx->vn    = NULL;
+  ctx->owned = false;
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu_with_scratch(), but for the divisor described by a
+ * context from divmnu_prepare(), so only the dividend has to be
+ * normalized; ws needs only m + 1 words.  ws may be u itself, given
+ * room for m + 1 words, to divide in place as divmnu_in_place() does.
+ */
+
+int
+divmnu_with_ctx_scratch (unsigned q[], unsigned r[], const unsigned u[],
+                         int m, const divmnu_ctx_t *ctx, unsigned ws[]);
+
+int
+divmnu_with_ctx_scratch (unsigned q[], unsigned r[], const unsigned u[],
+                         int m, const divmnu_ctx_t *ctx, unsigned ws[])
+{
+  if (m < ctx->n)
+    return 1;                                /* Return if invalid param. */
+
+  if (ctx->n == 1)
+    {
+      divmnu_1_preinv (q, r, u, m, ctx->vn[0], ctx->s, ctx->vinv);
+
+      return 0;
+    }
+
+  if (ctx->n == 2)
+    {
+      divmnu_2 (q, r, u, m, ctx->vn[1], ctx->vn[0], ctx->s, ctx->vinv3);
+
+      return 0;
+    }
+
+  divmnu_core (q, r, u, m, ctx, (kd_div_qhat_t)ctx->qhat, ctx->mulsub, ws);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu(), but for the divisor described by a context from
+ * divmnu_prepare(), so only the dividend has to be normalized.
+ */
+
+int
+divmnu_with_ctx (unsigned q[], unsigned r[], const unsigned u[], int m,
+                 const divmnu_ctx_t *ctx);
+
+int
+divmnu_with_ctx (unsigned q[], unsigned r[], const unsigned u[], int m,
+                 const divmnu_ctx_t *ctx)
+{
+  unsigned *ws;
+  int rc;
+
+  if (m < ctx->n)
+    return 1;                                /* Return if invalid param. */
+
+#ifdef __COMPCERT__
+  ws = malloc (sizeof (unsigned) * (size_t)(m + 1));
+
+  if (ws == NULL)
+    return 2;
+#else
+  ws = (unsigned *)alloca (4 * (size_t)(m + 1));
+#endif /* ifdef __COMPCERT__ */
+
+  rc = divmnu_with_ctx_scratch (q, r, u, m, ctx, ws);
+
+#ifdef __COMPCERT__
+  free (ws);
+#endif /* ifdef __COMPCERT__ */
+
+  return rc;
+}
+
+/****************************************************************************/
+
+/*
+ * Exact division: q = u / v, for a dividend u, m words, known to be a
+ * multiple of the divisor v, n words, with the same requirements on m,
+ * n and v as divmnu().  The quotient, m - n + 1 words, is found from the
+ * low words up, each digit being the low word of what is left of the
+ * dividend times the 2-adic inverse of v (Jebelean, "An algorithm for
+ * exact division"), so there is no normalization, no qhat to correct
+ * and no remainder.  Factors of 2 in v are first shifted out of both
+ * operands.  Each row is subtracted by the multiply-and-subtract kernel
+ * divmnu() would use.  ws is scratch space of divmnu_scratch_words(m, n)
+ * words.
+ *
+ * Returns 0 for success and 1 for invalid parameters.  If u is not a
+ * multiple of v, q is garbage; built with -DKD_DIV_EXACT_CHECK, each
+ * call is checked against divmnu(), and returns 3 if the division was
+ * not exact or the quotients differ (or 2 if out of memory).
+ */
+
+int
+divmnu_exact (unsigned q[], const unsigned u[], const unsigned v[], int m,
+              int n, unsigned ws[]);
+
+int
+divmnu_exact (unsigned q[], const unsigned u[], const unsigned v[], int m,
+              int n, unsigned ws[])
+{
+  int k, i, l;
+
+  if (m < n || n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  /*
+   * Shift u and v right by the k zero words and t zero bits at the
+   * bottom of v; only the low qn words of either are ever used.  w[qn]
+   * is the top word of the kernel for the last rows, and is not used.
+   */
+
+  const int qn = m - n + 1;
+
+  for (k = 0; v[k] == 0; k++)
+    ;
+
+  const int t  = 31 - nlz (v[k] & -v[k]);
+  const int nv = n - k < qn ? n - k : qn;
+  unsigned *w  = ws;                         /* What is left of u.       */
+  unsigned *vs = &ws[qn + 1];                /* Odd part of v.           */
+  kd_div_mulsub_t mulsub = kd_div_mulsub;
+
+#ifdef KD_DIV_TUNE
+  if (kd_div_tuned)
+    mulsub = kd_div_tune_find (nv)->mulsub;
+#endif /* ifdef KD_DIV_TUNE */
+
+  for (i = 0; i < qn; i++)
+    w[i] = (unsigned int)( ( (unsigned long long)u[i + k] >> t ) |
+             ( i + k + 1 < m
+                 ? (unsigned long long)u[i + k + 1] << (32 - t) : 0 ) );
+
+  for (i = 0; i < nv; i++)
+    vs[i] = (unsigned int)( ( (unsigned long long)v[i + k] >> t ) |
+              ( i + k + 1 < n
+                  ? (unsigned long long)v[i + k + 1] << (32 - t) : 0 ) );
+
+  const uint32_t vinv = inverse_word (vs[0]);
+
+  for (i = 0; i < qn; i++)
+    {
+      const int len = nv < qn - i ? nv : qn - i;
+
+      q[i] = w[i] * vinv;
+
+      /*
+       * Subtract q[i] * vs from w[i .. i+len], which zeroes w[i], and
+       * pass the borrow out of w[i+len] on up to w[qn-1].
+       */
+
+      if (mulsub (q[i], &w[i], vs, len))
+        for (l = i + len + 1; l < qn && w[l]-- == 0; l++)
+          ;
+    }
+
+#ifdef KD_DIV_EXACT_CHECK
+  {
+    unsigned *qc = malloc (sizeof (unsigned) * (size_t)(qn + n));
+    unsigned *rc = &qc[qn];
+    bool exact;
+
+    if (qc == NULL)
+      return 2;
+
+    exact = divmnu (qc, rc, u, v, m, n) == 0;
+
+    for (i = 0; i < n; i++)
+      exact = exact && rc[i] == 0;
+
+    for (i = 0; i < qn; i++)
+      exact = exact && qc[i] == q[i];
+
+    free (qc);
+
+    if (!exact)
+      return 3;
+  }
+#endif /* ifdef KD_DIV_EXACT_CHECK */
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Streaming division, for dividends too big to hold in memory.  The
+ * dividend is fed to divmnu_stream_feed() in pieces, most significant
+ * first, and only the running remainder (n words) and a chunk of
+ * KD_DIV_STREAM_CHUNK normalized dividend words below it are kept; each
+ * time the chunk fills up, its quotient words are computed and passed
+ * to the emit callback, most significant chunk first.  Memory is O(n)
+ * however long the dividend is.
+ */
+
+#define KD_DIV_STREAM_CHUNK 256
+
+/****************************************************************************/
+
+/*
+ * Start a streaming division by the divisor v, n words, with the same
+ * requirements on v and n as divmnu().  Returns 0 for success, 1 for
+ * invalid parameters and 2 if out of memory.
+ */
+
+int
+divmnu_stream_open (divmnu_stream_t *st, const unsigned v[], int n,
+                    divmnu_emit_t emit, void *arg);
+
+int
+divmnu_stream_open (divmnu_stream_t *st, const unsigned v[], int n,
+                    divmnu_emit_t emit, void *arg)
+{
+  int rc = divmnu_prepare (&st->ctx, v, n);
+
+  if (rc != 0)
+    return rc;
+
+  st->win = malloc (sizeof (unsigned) *
+                    (size_t)(2 * KD_DIV_STREAM_CHUNK + n));
+
+  if (st->win == NULL)
+    {
+      divmnu_release (&st->ctx);
+
+      return 2;
+    }
+
+  st->q    = &st->win[KD_DIV_STREAM_CHUNK + n];
+  st->emit = emit;
+  st->arg  = arg;
+  st->nw   = 0;
+  st->last = 0;
+  st->fill = 0;
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Divide the chunk (st->fill words, below the remainder in st->win),
+ * pass on its quotient words and move the remainder up above the next
+ * chunk.
+ */
+
+KD_DIV_LOCAL void
+kd_div_stream_chunk (divmnu_stream_t *st);
+
+KD_DIV_LOCAL void
+kd_div_stream_chunk (divmnu_stream_t *st)
+{
+  const int n    = st->ctx.n;
+  const int low  = KD_DIV_STREAM_CHUNK - st->fill;
+  unsigned *win  = st->win;
+
+  for (int j = KD_DIV_STREAM_CHUNK - 1; j >= low; j--)
+    if (n == 1)
+      {
+        divrem_t qr = divrem_64_by_32_preinv (
+                        ( (uint64_t)win[j + 1] << 32 ) | win[j],
+                        st->ctx.vn[0], st->ctx.vinv);
+
+        st->q[j] = qr.q;
+        win[j]   = qr.r;
+      }
+    else
+      st->q[j] = kd_div_digit (&win[j], &st->ctx,
+                               (kd_div_qhat_t)st->ctx.qhat, st->ctx.mulsub);
+
+  st->emit (st->arg, &st->q[low], st->fill);
+
+  (void)memmove (&win[KD_DIV_STREAM_CHUNK], &win[low],
+                 sizeof (unsigned) * (size_t)n);
+
+  st->fill = 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Append one normalized dividend word: the first n make up the initial
+ * remainder, the rest go into the chunk.
+ */
+
+static inline void
+kd_div_stream_put (divmnu_stream_t *st, unsigned w)
+{
+  const int n = st->ctx.n;
+
+  if (st->nw < n)
+    st->win[KD_DIV_STREAM_CHUNK + n - 1 - st->nw] = w;
+  else
+    {
+      st->win[KD_DIV_STREAM_CHUNK - 1 - st->fill] = w;
+
+      if (++st->fill == KD_DIV_STREAM_CHUNK)
+        kd_div_stream_chunk (st);
+    }
+
+  st->nw++;
+}
+
+/****************************************************************************/
+
+/*
+ * Feed the next k dividend words, u[k - 1] the most significant, which
+ * go just below those fed before.
+ */
+
+void
+divmnu_stream_feed (divmnu_stream_t *st, const unsigned u[], long k);
+
+void
+divmnu_stream_feed (divmnu_stream_t *st, const unsigned u[], long k)
+{
+  const int s = st->ctx.s;
+
+  /*
+   * Each word fed completes the normalized word above it, which takes
+   * its top s bits; the first one completes the extra high-order word
+   * that divmnu() appends.
+   */
+
+  for (long i = k - 1; i >= 0; i--)
+    {
+      kd_div_stream_put (st, (unsigned int)( (st->last << s) |
+                           ( (unsigned long long)u[i] >> (32 - s) ) ));
+      st->last = u[i];
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Finish a streaming division: pass on the last quotient words, store
+ * the remainder in r (n words, unless r is NULL) and free st.  Returns
+ * 0 for success and 1 if fewer than n dividend words were fed, which
+ * divmnu() does not allow either.
+ */
+
+int
+divmnu_stream_close (divmnu_stream_t *st, unsigned r[]);
+
+int
+divmnu_stream_close (divmnu_stream_t *st, unsigned r[])
+{
+  const int n   = st->ctx.n;
+  const int s   = st->ctx.s;
+  unsigned *rem = &st->win[KD_DIV_STREAM_CHUNK];
+  int rc        = 1;
+
+  if (st->nw >= n)
+    {
+      kd_div_stream_put (st, st->last << s);
+
+      if (st->fill > 0)
+        kd_div_stream_chunk (st);
+
+      for (int i = 0; r != NULL && i < n; i++)
+        r[i] = (unsigned int)( (rem[i] >> s) |
+                 ( i + 1 < n && s != 0
+                     ? (unsigned long long)rem[i + 1] << (32 - s) : 0 ) );
+
+      rc = 0;
+    }
+
+  free (st->win);
+  divmnu_release (&st->ctx);
+
+  return rc;
+}
+
+/****************************************************************************/
+
+/*
+ * The emit callback of divmnu_file(): writes the quotient words to
+ * their place in the output file with pwrite().  The chunks come most
+ * significant first and the file is least significant first, so they
+ * go from the end back, each one in a single write at an off_t offset.
+ */
+
+typedef struct
+{
+  off_t at;                                  /* Words still to write.     */
+  int   fd;                                  /* Quotient file.            */
+  bool  failed;                              /* Set on a write error.     */
+  char  pad[3];
+} kd_div_file_emit_t;
+
+KD_DIV_LOCAL void
+kd_div_file_emit (void *arg, const unsigned q[], int nq);
+
+KD_DIV_LOCAL void
+kd_div_file_emit (void *arg, const unsigned q[], int nq)
+{
+  kd_div_file_emit_t *fe = arg;
+  const char *p          = (const char *)q;
+  size_t len             = sizeof (unsigned) * (size_t)nq;
+
+  fe->at -= nq;
+
+  off_t at = (off_t)sizeof (unsigned) * fe->at;
+
+  while (!fe->failed && len > 0)
+    {
+      ssize_t k = pwrite (fe->fd, p, len, at);
+
+      if (k <= 0)
+        fe->failed = true;
+      else
+        {
+          p   += k;
+          len -= (size_t)k;
+          at  += k;
+        }
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Divide the dividend in the file upath by v, n words, writing the
+ * quotient to the file qpath and the remainder to r (n words, unless r
+ * is NULL).  Both files hold the words as u[] and q[] do in memory,
+ * least significant first, so the quotient has size / 4 - n + 1 words.
+ * The dividend is mapped and streamed from its end through
+ * divmnu_stream_feed(); its pages are read once and stay reclaimable,
+ * and the rest of the memory used is O(n).  Returns 0 for success, 1
+ * for invalid parameters (qpath naming the same file as upath among
+ * them), 2 if out of memory (or if upath is too big to map) and 4 for
+ * an I/O error.
+ */
+
+int
+divmnu_file (const char *upath, const char *qpath, unsigned r[],
+             const unsigned v[], int n);
+
+int
+divmnu_file (const char *upath, const char *qpath, unsigned r[],
+             const unsigned v[], int n)
+{
+  divmnu_stream_t    st;
+  kd_div_file_emit_t fe;
+  struct stat        sb, qsb;
+  int                rc;
+
+  /* Check v and n before qpath is opened, and truncated. */
+
+  if (n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  int fd = open (upath, O_RDONLY);
+
+  if (fd < 0)
+    return 4;
+
+  if (fstat (fd, &sb) != 0)
+    {
+      (void)close (fd);
+
+      return 4;
+    }
+
+  /* Too big to map, or to count in a long, on this host. */
+
+  if ( (uintmax_t)sb.st_size > SIZE_MAX ||
+       (uintmax_t)sb.st_size / sizeof (unsigned) > LONG_MAX )
+    {
+      (void)close (fd);
+
+      return 2;
+    }
+
+  long m = (long)(sb.st_size / (off_t)sizeof (unsigned));
+
+  if (m == 0 || m < n || sb.st_size % (off_t)sizeof (unsigned) != 0)
+    {
+      (void)close (fd);
+
+      return 1;
+    }
+
+  /*
+   * Open qpath without truncating it, and give up if it is upath under
+   * another name: truncating the mapped dividend would fault.
+   */
+
+  int qfd = open (qpath, O_WRONLY | O_CREAT, 0666);
+
+  if (qfd < 0 || fstat (qfd, &qsb) != 0)
+    rc = 4;
+  else if (qsb.st_dev == sb.st_dev && qsb.st_ino == sb.st_ino)
+    rc = 1;
+  else
+    rc = 0;
+
+  if (rc != 0)
+    {
+      if (qfd >= 0)
+        (void)close (qfd);
+
+      (void)close (fd);
+
+      return rc;
+    }
+
+  const unsigned *u = mmap (NULL, (size_t)sb.st_size, PROT_READ,
+                            MAP_PRIVATE, fd, 0);
+
+  (void)close (fd);
+
+  if (u == MAP_FAILED)
+    {
+      (void)close (qfd);
+
+      return 4;
+    }
+
+  /* Give the quotient file its final size, then fill it in. */
+
+  fe.at     = (off_t)(m - n + 1);
+  fe.fd     = qfd;
+  fe.failed = ftruncate (qfd, (off_t)sizeof (unsigned) * fe.at) != 0;
+
+  rc = fe.failed ? 4 : divmnu_stream_open (&st, v, n, kd_div_file_emit,
+                                           &fe);
+
+  if (rc == 0)
+    {
+      divmnu_stream_feed (&st, u, m);
+      rc = divmnu_stream_close (&st, r);
+    }
+
+  if (close (qfd) != 0)
+    fe.failed = true;
+
+  (void)munmap ( (void *)u, (size_t)sb.st_size );
+
+  return rc == 0 && fe.failed ? 4 : rc;
+}
+
+/****************************************************************************/
+
+/*
+ * w = a * b mod b**nw, where a has na words and b has nb words, one
+ * bigmuladd() row per word of a.  With nw = na + nb this is the full
+ * schoolbook product; a smaller nw skips the work for the words that
+ * are not wanted.  w must not overlap a or b.
+ */
+
+KD_DIV_LOCAL void
+bigmulmn (unsigned w[], unsigned a[], int na, unsigned b[], int nb, int nw);
+
+KD_DIV_LOCAL void
+bigmulmn (unsigned w[], unsigned a[], int na, unsigned b[], int nb, int nw)
+{
+  for (int i = 0; i < nw; i++)
+    w[i] = 0;
+
+  for (int i = 0; i < na && i < nw; i++)
+    {
+      int len = nw - i < nb ? nw - i : nb;   /* Words of b wanted.       */
+
+      if (a[i] == 0)
+        continue;
+
+      /* w[i + nb] is still zero: no earlier row reaches it. */
+
+      uint32_t k = kd_div_muladd (a[i], &w[i], b, len);
+
+      if (i + len < nw)
+        w[i + len] = k;
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * The words lo .. na+nb-1 of a * b, less the carries from the partial
+ * products a[i] * b[j] with i + j < lo, which are skipped (HAC 14.44):
+ * the result w, of na + nb - lo words, is short of the true high part
+ * by less than lo units of w[1].  w must not overlap a or b.
+ */
+
+KD_DIV_LOCAL void
+bigmulhi (unsigned w[], unsigned a[], int na, unsigned b[], int nb, int lo);
+
+KD_DIV_LOCAL void
+bigmulhi (unsigned w[], unsigned a[], int na, unsigned b[], int nb, int lo)
+{
+  for (int i = 0; i < na + nb - lo; i++)
+    w[i] = 0;
+
+  for (int i = 0; i < na; i++)
+    {
+      int j = lo - i > 0 ? lo - i : 0;       /* First b[j] wanted.       */
+
+      if (j >= nb || a[i] == 0)
+        continue;
+
+      w[i + nb - lo] = kd_div_muladd (a[i], &w[i + j - lo], &b[j], nb - j);
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Barrett reduction by a fixed modulus v of n words (HAC 14.42).
+ * divmnu_barrett_prepare() computes mu = floor(b**(2n) / v) once, with
+ * divmnu(); divmnu_barrett_reduce() then reduces any x < b**(2n) with
+ * two truncated multiplications and at most three final subtractions.
+ * Its state, scratch space included, is a divmnu_barrett_t, declared in
+ * divmnu.h; one divmnu_barrett_t must not be used by two threads at
+ * once.
+ */
+
+/****************************************************************************/
+
+/*
+ * Prepare br for reduction modulo v, n words, v[n-1] != 0.  Returns 0
+ * for success, 1 for invalid parameters and 2 if out of memory.
+ */
+
+int
+divmnu_barrett_prepare (divmnu_barrett_t *br, const unsigned v[], int n);
+
+int
+divmnu_barrett_prepare (divmnu_barrett_t *br, const unsigned v[], int n)
+{
+  unsigned *b2n;
+
+  if (n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  br->n  = n;
+  br->v  = calloc ( (size_t)(n + 1), sizeof (unsigned) );
+  br->mu = calloc ( (size_t)(n + 2), sizeof (unsigned) );
+  br->ws = malloc ( (size_t)(3 * n + 6) * sizeof (unsigned) );
+  b2n    = calloc ( (size_t)(2 * n + 1), sizeof (unsigned) );
+
+  if (br->v == NULL || br->mu == NULL || br->ws == NULL || b2n == NULL)
+    {
+      free (br->v);
+      free (br->mu);
+      free (br->ws);
+      free (b2n);
+
+      return 2;
+    }
+
+  for (int i = 0; i < n; i++)
+    br->v[i] = v[i];
+
+  /* mu = floor(b**(2n) / v), at most n + 2 words. */
+
+  b2n[2 * n] = 1;
+
+  (void)divmnu (br->mu, NULL, b2n, v, 2 * n + 1, n);
+
+  free (b2n);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+void
+divmnu_barrett_release (divmnu_barrett_t *br);
+
+void
+divmnu_barrett_release (divmnu_barrett_t *br)
+{
+  free (br->v);
+  free (br->mu);
+  free (br->ws);
+
+  br->v  = NULL;
+  br->mu = NULL;
+  br->ws = NULL;
+}
+
+/****************************************************************************/
+
+/*
+ * r = x mod v, for x of 2n words (x < b**(2n)) and r of n words.
+ */
+
+void
+divmnu_barrett_reduce (unsigned r[], const unsigned x[],
+                       const divmnu_barrett_t *br);
+
+void
+divmnu_barrett_reduce (unsigned r[], const unsigned x[],
+                       const divmnu_barrett_t *br)
+{
+  const int n  = br->n;
+  unsigned *q2 = br->ws;                     /* n + 4 words              */
+  unsigned *r2 = &q2[n + 4];                 /* n + 1 words              */
+  unsigned *t  = &r2[n + 1];                 /* n + 1 words              */
+
+  /*
+   * q3 = floor(floor(x / b**(n-1)) * mu / b**(n+1)), i.e. the top words
+   * of q1 * mu with q1 = x[n-1 .. 2n-1], from the partial products that
+   * reach word n - 1 and up only.  The true q3 is at most two less than
+   * the quotient, and the skipped carries take at most one more off.
+   */
+
+  bigmulhi (q2, (unsigned *)&x[n - 1], n + 1, br->mu, n + 2, n - 1);
+
+  unsigned *q3 = &q2[2];
+
+  /* r2 = q3 * v mod b**(n+1): only the low n + 1 words are needed. */
+
+  bigmulmn (r2, q3, n + 1, br->v, n, n + 1);
+
+  /* r = (x mod b**(n+1)) - r2, mod b**(n+1); this is x - q3 * v. */
+
+  (void)bigsub (r2, r2, (unsigned *)x, 0, n, true);
+
+  /* At most three subtractions of v bring r below v. */
+
+  while (bigsub (t, br->v, r2, 0, n, true))
+    for (int i = 0; i <= n; i++)
+      r2[i] = t[i];
+
+  for (int i = 0; i < n; i++)
+    r[i] = r2[i];
+}
+
+/****************************************************************************/
+
+/*
+ * Montgomery arithmetic modulo an odd modulus mod of n words, with
+ * R = b**n.  divmnu() is used only to bring numbers into Montgomery
+ * form (a * R mod mod); products are reduced word by word with
+ * divmnu_mont_mul(), and divmnu_mont_leave() multiplies by plain 1 to
+ * take the R back out.  Its state is a divmnu_mont_t, declared in
+ * divmnu.h.
+ */
+
+/****************************************************************************/
+
+/*
+ * Prepare mt for arithmetic modulo mod, n words, mod odd and
+ * mod[n-1] != 0.  Returns 0 for success, 1 for invalid parameters and
+ * 2 if out of memory.
+ */
+
+int
+divmnu_mont_prepare (divmnu_mont_t *mt, const unsigned mod[], int n);
+
+int
+divmnu_mont_prepare (divmnu_mont_t *mt, const unsigned mod[], int n)
+{
+  unsigned *rn, *q;
+
+  if (n <= 0 || mod[n - 1] == 0 || (mod[0] & 1) == 0)
+    return 1;                                /* Return if invalid param. */
+
+  mt->n   = n;
+  mt->mod = calloc ( (size_t)(n + 1), sizeof (unsigned) );
+  mt->one = calloc ( (size_t)n, sizeof (unsigned) );
+  rn      = calloc ( (size_t)(n + 1), sizeof (unsigned) );
+  q       = calloc ( 2, sizeof (unsigned) );
+
+  if (mt->mod == NULL || mt->one == NULL || rn == NULL || q == NULL)
+    {
+      free (mt->mod);
+      free (mt->one);
+      free (rn);
+      free (q);
+
+      return 2;
+    }
+
+  for (int i = 0; i < n; i++)
+    mt->mod[i] = mod[i];
+
+  mt->minv = -inverse_word (mod[0]);
+
+  /* one = R mod mod. */
+
+  rn[n] = 1;
+
+  (void)divmnu (q, mt->one, rn, mod, n + 1, n);
+
+  free (rn);
+  free (q);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+void
+divmnu_mont_release (divmnu_mont_t *mt);
+
+void
+divmnu_mont_release (divmnu_mont_t *mt)
+{
+  free (mt->mod);
+  free (mt->one);
+
+  mt->mod = NULL;
+  mt->one = NULL;
+}
+
+/****************************************************************************/
+
+/*
+ * r = a * b / R mod mod, for a and b of n words in Montgomery form (less
+ * than mod), by coarsely integrated operand scanning (CIOS): each word
+ * of b is multiplied in and one word of the sum is reduced away before
+ * the next, so the running sum t never exceeds n + 2 words.  t is
+ * scratch space of n + 2 words; r may be the same as a or b.
+ */
+
+void
+divmnu_mont_mul (unsigned r[], const unsigned a[], const unsigned b[],
+                 const divmnu_mont_t *mt, unsigned t[]);
+
+void
+divmnu_mont_mul (unsigned r[], const unsigned a[], const unsigned b[],
+                 const divmnu_mont_t *mt, unsigned t[])
+{
+  const int n           = mt->n;
+  const unsigned *mod   = mt->mod;
+  uint64_t value;
+  uint32_t carry;
+
+  for (int j = 0; j < n + 2; j++)
+    t[j] = 0;
+
+  for (int i = 0; i < n; i++)
+    {
+      /* t = t + a * b[i]. */
+
+      carry = 0;
+
+      for (int j = 0; j < n; j++)
+        {
+          value = (uint64_t)a[j] * b[i] + t[j] + carry;
+          t[j]  = (uint32_t)value;
+          carry = (uint32_t)(value >> 32);
+        }
+
+      value    = (uint64_t)t[n] + carry;
+      t[n]     = (uint32_t)value;
+      t[n + 1] = (uint32_t)(value >> 32);
+
+      /* t = (t + mi * mod) / b, with mi chosen to clear the low word. */
+
+      uint32_t mi = t[0] * mt->minv;
+
+      value = (uint64_t)mi * mod[0] + t[0];
+      carry = (uint32_t)(value >> 32);
+
+      for (int j = 1; j < n; j++)
+        {
+          value    = (uint64_t)mi * mod[j] + t[j] + carry;
+          t[j - 1] = (uint32_t)value;
+          carry    = (uint32_t)(value >> 32);
+        }
+
+      value    = (uint64_t)t[n] + carry;
+      t[n - 1] = (uint32_t)value;
+      t[n]     = t[n + 1] + (uint32_t)(value >> 32);
+    }
+
+  /* t < 2 * mod; subtract mod once if t >= mod. */
+
+  bool ge = t[n] != 0;
+
+  if (!ge)
+    {
+      int j = n - 1;
+
+      while (j > 0 && t[j] == mod[j])
+        j--;
+
+      ge = t[j] >= mod[j];
+    }
+
+  if (ge)
+    (void)bigsub (r, (unsigned *)mod, t, 0, n - 1, true);
+  else
+    for (int j = 0; j < n; j++)
+      r[j] = t[j];
+}
+
+/****************************************************************************/
+
+/*
+ * r = a * R mod mod, for a of na words (any size), with divmnu().
+ * Returns 0 for success and 2 if out of memory.
+ */
+
+int
+divmnu_mont_enter (unsigned r[], const unsigned a[], int na,
+                   const divmnu_mont_t *mt);
+
+int
+divmnu_mont_enter (unsigned r[], const unsigned a[], int na,
+                   const divmnu_mont_t *mt)
+{
+  const int n = mt->n;
+  unsigned *u = calloc ( (size_t)(na + n), sizeof (unsigned) );
+  unsigned *q = malloc ( sizeof (unsigned) * (size_t)(na + 1) );
+
+  if (u == NULL || q == NULL)
+    {
+      free (u);
+      free (q);
+
+      return 2;
+    }
+
+  for (int i = 0; i < na; i++)
+    u[n + i] = a[i];
+
+  (void)divmnu (q, r, u, mt->mod, na + n, n);
+
+  free (u);
+  free (q);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * r = a / R mod mod, for a of n words in Montgomery form.  t is scratch
+ * space of 2n + 2 words.
+ */
+
+void
+divmnu_mont_leave (unsigned r[], const unsigned a[], const divmnu_mont_t *mt,
+                   unsigned t[]);
+
+void
+divmnu_mont_leave (unsigned r[], const unsigned a[], const divmnu_mont_t *mt,
+                   unsigned t[])
+{
+  unsigned *plain_one = &t[mt->n + 2];
+
+  for (int i = 0; i < mt->n; i++)
+    plain_one[i] = i == 0;
+
+  divmnu_mont_mul (r, a, plain_one, mt, t);
+}
+
+/****************************************************************************/
+
+/*
+ * r = g**e mod mod, by left-to-right sliding-window exponentiation in
+ * Montgomery form.  g has ng words (any size), e has ne words (ne >= 0),
+ * mod has n words and must be odd with mod[n-1] != 0, and r has n
+ * words.  The window is widened with the length of e, from one bit
+ * (plain square-and-multiply) up to six bits, so that the table of odd
+ * powers g, g**3, ..., g**(2**k - 1) stays small next to the work it
+ * saves.  Returns 0 for success, 1 for invalid parameters and 2 if out
+ * of memory.
+ */
+
+int
+divmnu_modexp (unsigned r[], const unsigned g[], int ng, const unsigned e[],
+               int ne, const unsigned mod[], int n);
+
+int
+divmnu_modexp (unsigned r[], const unsigned g[], int ng, const unsigned e[],
+               int ne, const unsigned mod[], int n)
+{
+  divmnu_mont_t mt;
+  int f, bits = 32 * ne;
+
+  if (ng <= 0 || ne < 0)
+    return 1;                                /* Return if invalid param. */
+
+  if ( (f = divmnu_mont_prepare (&mt, mod, n)) != 0 )
+    return f;
+
+  while (bits > 0 && (e[(bits - 1) / 32] >> ( (bits - 1) % 32 ) & 1) == 0)
+    bits--;
+
+  int k = bits > 671 ? 6 : bits > 239 ? 5 : bits > 79 ? 4 :
+            bits > 23 ? 3 : bits > 7 ? 2 : 1;
+
+  /* odd[i] = g**(2i + 1), g2 = g**2, a = 1 and t, 2n + 2 words of scratch. */
+
+  int nodd      = 1 << (k - 1);
+  unsigned *odd = malloc ( sizeof (unsigned) * (size_t)( (nodd + 4) * n + 2) );
+
+  if (odd == NULL)
+    {
+      divmnu_mont_release (&mt);
+      return 2;
+    }
+
+  unsigned *g2 = &odd[nodd * n];
+  unsigned *a  = &g2[n];
+  unsigned *t  = &a[n];
+
+  if (divmnu_mont_enter (odd, g, ng, &mt) != 0)
+    {
+      free (odd);
+      divmnu_mont_release (&mt);
+
+      return 2;
+    }
+
+  divmnu_mont_mul (g2, odd, odd, &mt, t);
+
+  for (int i = 1; i < nodd; i++)
+    divmnu_mont_mul (&odd[i * n], &odd[(i - 1) * n], g2, &mt, t);
+
+  for (int i = 0; i < n; i++)
+    a[i] = mt.one[i];
+
+  /*
+   * Scan e from the top.  A zero bit is a squaring; a one bit starts a
+   * window of up to k bits that ends in a one bit, which is squared in
+   * bit by bit and then multiplied by the matching odd power.
+   */
+
+  for (int i = bits - 1; i >= 0; )
+    {
+      if ( (e[i / 32] >> (i % 32) & 1) == 0 )
+        {
+          divmnu_mont_mul (a, a, a, &mt, t);
+          i--;
+          continue;
+        }
+
+      int l = i - k + 1 > 0 ? i - k + 1 : 0;
+
+      while ( (e[l / 32] >> (l % 32) & 1) == 0 )
+        l++;
+
+      unsigned w = 0;
+
+      for (int j = i; j >= l; j--)
+        {
+          w = w << 1 | (e[j / 32] >> (j % 32) & 1);
+          divmnu_mont_mul (a, a, a, &mt, t);
+        }
+
+      divmnu_mont_mul (a, a, &odd[(w >> 1) * n], &mt, t);
+
+      i = l - 1;
+    }
+
+  divmnu_mont_leave (r, a, &mt, t);
+
+  free (odd);
+  divmnu_mont_release (&mt);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+#ifndef KD_DIV_LIBRARY
+
+/*
+ * Reference for divmnu_modexp(), with the same arguments and results:
+ * right-to-left square-and-multiply where every product is reduced by a
+ * divmnu() call whose quotient is thrown away.
+ */
+
+KD_DIV_LOCAL int
+divmnu_modexp_ref (unsigned r[], const unsigned g[], int ng,
+                   const unsigned e[], int ne, const unsigned mod[], int n);
+
+KD_DIV_LOCAL int
+divmnu_modexp_ref (unsigned r[], const unsigned g[], int ng,
+                   const unsigned e[], int ne, const unsigned mod[], int n)
+{
+  if (n <= 0 || mod[n - 1] == 0 || ng <= 0 || ne < 0)
+    return 1;                                /* Return if invalid param. */
+
+  int len     = ng > 2 * n ? ng : 2 * n;
+  unsigned *s = calloc ( (size_t)(2 * n + 2 * len + 1), sizeof (unsigned) );
+
+  if (s == NULL)
+    return 2;
+
+  unsigned *base = s;                        /* n words                  */
+  unsigned *acc  = &base[n];                 /* n words                  */
+  unsigned *prod = &acc[n];                  /* len words                */
+  unsigned *q    = &prod[len];               /* len + 1 words            */
+
+  /* base = g mod mod; acc = 1 mod mod. */
+
+  if (ng >= n)
+    (void)divmnu (q, base, g, mod, ng, n);
+  else
+    for (int i = 0; i < ng; i++)
+      base[i] = g[i];
+
+  prod[0] = 1;
+
+  for (int i = 1; i < n; i++)
+    prod[i] = 0;
+
+  (void)divmnu (q, acc, prod, mod, n, n);
+
+  for (int i = 0; i < 32 * ne; i++)
+    {
+      if (e[i / 32] >> (i % 32) & 1)
+        {
+          bigmulmn (prod, acc, n, base, n, 2 * n);
+          (void)divmnu (q, acc, prod, mod, 2 * n, n);
+        }
+
+      bigmulmn (prod, base, n, base, n, 2 * n);
+      (void)divmnu (q, base, prod, mod, 2 * n, n);
+    }
+
+  for (int i = 0; i < n; i++)
+    r[i] = acc[i];
+
+  free (s);
+
+  return 0;
+}
+
+#endif /* ifndef KD_DIV_LIBRARY */
+
+/****************************************************************************/
+
+/*
+ * w = w + a, for w of nw words and a of na <= nw words.  Returns the
+ * carry out of w.
+ */
+
+KD_DIV_LOCAL bool
+kd_div_add_into (unsigned w[], int nw, const unsigned a[], int na);
+
+KD_DIV_LOCAL bool
+kd_div_add_into (unsigned w[], int nw, const unsigned a[], int na)
+{
+  uint32_t carry = 0;
+  int i;
+
+  for (i = 0; i < na; i++)
+    {
+      uint64_t value = (uint64_t)w[i] + a[i] + carry;
+      w[i]           = (uint32_t)value;
+      carry          = (uint32_t)(value >> 32);
+    }
+
+  for (; carry != 0 && i < nw; i++)
+    carry = ++w[i] == 0;
+
+  return carry != 0;
+}
+
+/****************************************************************************/
+
+/*
+ * w = w - a, for w of nw words and a of na <= nw words.  Returns the
+ * borrow out of w.
+ */
+
+KD_DIV_LOCAL bool
+kd_div_sub_from (unsigned w[], int nw, const unsigned a[], int na);
+
+KD_DIV_LOCAL bool
+kd_div_sub_from (unsigned w[], int nw, const unsigned a[], int na)
+{
+  uint32_t borrow = 0;
+  int i;
+
+  for (i = 0; i < na; i++)
+    {
+      uint64_t value = (uint64_t)w[i] - a[i] - borrow;
+      w[i]           = (uint32_t)value;
+      borrow         = (uint32_t)(value >> 32) & 1;
+    }
+
+  for (; borrow != 0 && i < nw; i++)
+    borrow = w[i]-- == 0;
+
+  return borrow != 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Number-theoretic transform (NTT) multiplication, for factors so long
+ * that even Karatsuba's method is slow.  The product of two numbers of
+ * 32-bit words is a convolution of their words, whose terms are below
+ * 2**88 for products of up to 2**24 words; it is computed modulo three
+ * primes p = c * 2**k + 1 below 2**31, whose 2**k-th roots of unity
+ * give transforms of up to 2**24 points, and the terms are put back
+ * together by the Chinese remainder theorem.  Arithmetic modulo each
+ * prime is done in Montgomery form with R = 2**32.
+ */
+
+typedef struct
+{
+  uint32_t p;                                /* c * 2**k + 1              */
+  uint32_t g;                                /* A primitive root mod p.   */
+  uint32_t pinv;                             /* -p**-1 mod 2**32          */
+  uint32_t r2;                               /* R**2 mod p                */
+} kd_div_ntt_prime_t;
+
+#define KD_DIV_NTT_P1 2013265921U            /* 15 * 2**27 + 1            */
+#define KD_DIV_NTT_P2  469762049U            /*  7 * 2**26 + 1            */
+#define KD_DIV_NTT_P3  754974721U            /* 45 * 2**24 + 1            */
+#define KD_DIV_NTT_MAX (1 << 24)
+
+/*
+ * Size, in words, of the shorter factor from which kd_div_karatsuba()
+ * and kd_div_mul() multiply by NTT; "make tune" sets it.
+ */
+
+#ifndef KD_DIV_NTT_THRESHOLD
+# define KD_DIV_NTT_THRESHOLD 512
+#endif /* ifndef KD_DIV_NTT_THRESHOLD */
+
+KD_DIV_LOCAL int kd_div_ntt_threshold = KD_DIV_NTT_THRESHOLD;
+
+/****************************************************************************/
+
+KD_DIV_LOCAL uint32_t
+kd_div_ntt_pow (uint32_t x, uint32_t e, uint32_t p);
+
+KD_DIV_LOCAL uint32_t
+kd_div_ntt_pow (uint32_t x, uint32_t e, uint32_t p)
+{
+  uint64_t y = 1;
+
+  for (uint64_t z = x % p; e != 0; e >>= 1, z = z * z % p)
+    if (e & 1)
+      y = y * z % p;
+
+  return (uint32_t)y;
+}
+
+/****************************************************************************/
+
+KD_DIV_LOCAL void
+kd_div_ntt_setup (kd_div_ntt_prime_t *pr, uint32_t p, uint32_t g);
+
+KD_DIV_LOCAL void
+kd_div_ntt_setup (kd_div_ntt_prime_t *pr, uint32_t p, uint32_t g)
+{
+  uint32_t inv = p;
+
+  for (int i = 0; i < 4; i++)
+    inv *= 2 - p * inv;
+
+  uint64_t r = ( (uint64_t)1 << 32 ) % p;
+
+  pr->p    = p;
+  pr->g    = g;
+  pr->pinv = -inv;
+  pr->r2   = (uint32_t)(r * r % p);
+}
+
+/****************************************************************************/
+
+/*
+ * a * b / R mod p, for a * b < p * 2**32.
+ */
+
+static inline uint32_t
+kd_div_ntt_mul (uint32_t a, uint32_t b, const kd_div_ntt_prime_t *pr)
+{
+  uint64_t t = (uint64_t)a * b;
+  uint32_t m = (uint32_t)t * pr->pinv;
+  uint32_t u = (uint32_t)( (t + (uint64_t)m * pr->p) >> 32 );
+
+  return u >= pr->p ? u - pr->p : u;
+}
+
+/****************************************************************************/
+
+/*
+ * In-place transform of a, nt points (a power of two), with the roots
+ * of unity rt[j] = w**j R mod p, j < nt / 2.  The forward transform
+ * (decimation in frequency) takes a in natural order and leaves it in
+ * bit-reversed order; the inverse (decimation in time, with the roots
+ * of w**-1) takes bit-reversed order back to natural order, unscaled.
+ */
+
+KD_DIV_LOCAL void
+kd_div_ntt (uint32_t a[], int nt, const uint32_t rt[], bool inverse,
+            const kd_div_ntt_prime_t *pr);
+
+KD_DIV_LOCAL void
+kd_div_ntt (uint32_t a[], int nt, const uint32_t rt[], bool inverse,
+            const kd_div_ntt_prime_t *pr)
+{
+  const uint32_t p = pr->p;
+
+  for (int len = inverse ? 2 : nt; len >= 2 && len <= nt;
+       len = inverse ? len << 1 : len >> 1)
+    {
+      int half = len / 2;
+      int step = nt / len;
+
+      for (int i = 0; i < nt; i += len)
+        for (int j = 0; j < half; j++)
+          {
+            uint32_t x = a[i + j];
+            uint32_t y = a[i + j + half];
+
+            if (inverse)
+              {
+                y = kd_div_ntt_mul (y, rt[j * step], pr);
+
+                a[i + j]        = x + y >= p ? x + y - p : x + y;
+                a[i + j + half] = x >= y ? x - y : x + p - y;
+              }
+            else
+              {
+                a[i + j]        = x + y >= p ? x + y - p : x + y;
+                a[i + j + half] = kd_div_ntt_mul (x >= y ? x - y : x + p - y,
+                                                  rt[j * step], pr);
+              }
+          }
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Words of scratch space needed by kd_div_ntt_product() for a product
+ * of nw words.
+ */
+
+KD_DIV_LOCAL int
+kd_div_ntt_scratch (int nw);
+
+KD_DIV_LOCAL int
+kd_div_ntt_scratch (int nw)
+{
+  int nt = 1;
+
+  while (nt < nw)
+    nt <<= 1;
+
+  return 6 * nt;
+}
+
+/****************************************************************************/
+
+/*
+ * w = a * b, for a of na words, b of nb words and w of na + nb <=
+ * KD_DIV_NTT_MAX words, by NTT.  ws is scratch space of
+ * kd_div_ntt_scratch(na + nb) words; w must not overlap a, b or ws.
+ * Use kd_div_ntt_mul_fit() rather than this directly.
+ */
+
+KD_DIV_LOCAL void
+kd_div_ntt_product (unsigned w[], const unsigned a[], int na,
+                    const unsigned b[], int nb, unsigned ws[]);
+
+KD_DIV_LOCAL void
+kd_div_ntt_product (unsigned w[], const unsigned a[], int na,
+                    const unsigned b[], int nb, unsigned ws[])
+{
+  static const uint32_t prime[3][2] = {
+    { KD_DIV_NTT_P1, 31 }, { KD_DIV_NTT_P2, 3 }, { KD_DIV_NTT_P3, 11 }
+  };
+
+  kd_div_ntt_prime_t pr[3];
+  int nt = 1;
+
+  while (nt < na + nb)
+    nt <<= 1;
+
+  uint32_t *res = ws;                        /* 3 * nt: a * b mod p[k]   */
+  uint32_t *fb  = &res[3 * nt];              /* nt                       */
+  uint32_t *rt  = &fb[nt];                   /* nt / 2 roots, nt / 2     */
+  uint32_t *irt = &rt[nt / 2];               /*   inverse roots          */
+
+  for (int k = 0; k < 3; k++)
+    {
+      kd_div_ntt_prime_t *pk = &pr[k];
+      uint32_t *fa           = &res[k * nt];
+
+      kd_div_ntt_setup (pk, prime[k][0], prime[k][1]);
+
+      const uint32_t p  = pk->p;
+      uint32_t w        = kd_div_ntt_pow (pk->g, (p - 1) / (uint32_t)nt, p);
+      uint32_t wm       = kd_div_ntt_mul (w, pk->r2, pk);
+      uint32_t iwm      = kd_div_ntt_mul (kd_div_ntt_pow (w, p - 2, p),
+                                          pk->r2, pk);
+
+      rt[0]  = kd_div_ntt_mul (1, pk->r2, pk);
+      irt[0] = rt[0];
+
+      for (int j = 1; j < nt / 2; j++)
+        {
+          rt[j]  = kd_div_ntt_mul (rt[j - 1], wm, pk);
+          irt[j] = kd_div_ntt_mul (irt[j - 1], iwm, pk);
+        }
+
+      for (int i = 0; i < nt; i++)
+        {
+          fa[i] = i < na ? a[i] % p : 0;
+          fb[i] = i < nb ? b[i] % p : 0;
+        }
+
+      kd_div_ntt (fa, nt, rt, false, pk);
+      kd_div_ntt (fb, nt, rt, false, pk);
+
+      /* fa * fb / R, then times R / nt to undo that and the scaling. */
+
+      uint32_t scale = kd_div_ntt_pow ( (uint32_t)nt, p - 2, p);
+
+      scale = kd_div_ntt_mul (scale, pk->r2, pk);
+      scale = kd_div_ntt_mul (scale, pk->r2, pk);
+
+      for (int i = 0; i < nt; i++)
+        fa[i] = kd_div_ntt_mul (fa[i], fb[i], pk);
+
+      kd_div_ntt (fa, nt, irt, true, pk);
+
+      for (int i = 0; i < na + nb - 1; i++)
+        fa[i] = kd_div_ntt_mul (fa[i], scale, pk);
+    }
+
+  /*
+   * Garner's method: x = x1 + p1 (x2 + p2 x3) with x1 < p1, x2 < p2 and
+   * x3 < p3, added into w a word at a time with a three-word carry.
+   */
+
+  const uint64_t p1   = KD_DIV_NTT_P1;
+  const uint64_t p2   = KD_DIV_NTT_P2;
+  const uint64_t p3   = KD_DIV_NTT_P3;
+  const uint64_t p12  = p1 * p2;
+  const uint64_t i12  = kd_div_ntt_pow (KD_DIV_NTT_P1 % KD_DIV_NTT_P2,
+                                        KD_DIV_NTT_P2 - 2, KD_DIV_NTT_P2);
+  const uint64_t i123 = kd_div_ntt_pow ( (uint32_t)(p12 % p3),
+                                         KD_DIV_NTT_P3 - 2, KD_DIV_NTT_P3);
+  uint32_t c0 = 0, c1 = 0, c2 = 0;
+
+  for (int i = 0; i < na + nb; i++)
+    {
+      uint32_t w0 = 0, w1 = 0, w2 = 0;
+
+      if (i < na + nb - 1)
+        {
+          uint64_t x1 = res[i];
+          uint64_t x2 = (res[nt + i] + p2 - x1 % p2) % p2 * i12 % p2;
+          uint64_t x3 = (res[2 * nt + i] + p3 - x1 % p3) % p3;
+
+          x3 = (x3 + p3 - p1 % p3 * x2 % p3) % p3 * i123 % p3;
+
+          /* x1 + p1 x2 < 2**62; p12 x3 < 2**90. */
+
+          uint64_t lo  = x1 + p1 * x2;
+          uint64_t mlo = (p12 & 0xffffffff) * x3;
+          uint64_t mhi = (p12 >> 32) * x3;
+          uint64_t s0  = (lo & 0xffffffff) + (mlo & 0xffffffff);
+          uint64_t s1  = (lo >> 32) + (mlo >> 32) + (mhi & 0xffffffff) +
+                           (s0 >> 32);
+
+          w0 = (uint32_t)s0;
+          w1 = (uint32_t)s1;
+          w2 = (uint32_t)( (mhi >> 32) + (s1 >> 32) );
+        }
+
+      uint64_t lo  = (uint64_t)c0 + w0;
+      uint64_t mid = (uint64_t)c1 + w1 + (lo >> 32);
+      uint64_t hi  = (uint64_t)c2 + w2 + (mid >> 32);
+
+      w[i] = (uint32_t)lo;
+      c0   = (uint32_t)mid;
+      c1   = (uint32_t)hi;
+      c2   = (uint32_t)(hi >> 32);
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Same as kd_div_ntt_product(), but a product that is only a few words
+ * longer than a power of two, which would need a transform twice as
+ * long, is split as a * b = a0 * b0 + a0 * b1 * b**nb0 + a1 * b * b**na0
+ * with a0 and b0 of na0 and nb0 words short enough for the smaller
+ * transform, and the two thin products done by bigmulmn().
+ */
+
+KD_DIV_LOCAL void
+kd_div_ntt_mul_fit (unsigned w[], const unsigned a[], int na,
+                    const unsigned b[], int nb, unsigned ws[]);
+
+KD_DIV_LOCAL void
+kd_div_ntt_mul_fit (unsigned w[], const unsigned a[], int na,
+                    const unsigned b[], int nb, unsigned ws[])
+{
+  int nt = 1;
+
+  while (nt < na + nb)
+    nt <<= 1;
+
+  int e  = na + nb - nt / 2;                 /* Words over nt / 2.       */
+  int ea = (e + 1) / 2;
+  int eb = e - ea;
+
+  if (e > (na + nb) / 16 || ea >= na || eb >= nb)
+    {
+      kd_div_ntt_product (w, a, na, b, nb, ws);
+      return;
+    }
+
+  int na0        = na - ea;
+  int nb0        = nb - eb;
+  unsigned *t    = ws;                       /* na + nb words            */
+  unsigned *rest = &t[na + nb];
+
+  kd_div_ntt_product (w, a, na0, b, nb0, rest);
+
+  for (int i = na0 + nb0; i < na + nb; i++)
+    w[i] = 0;
+
+  bigmulmn (t, (unsigned *)&a[na0], ea, (unsigned *)b, nb, ea + nb);
+  (void)kd_div_add_into (&w[na0], na + nb - na0, t, ea + nb);
+
+  if (eb > 0)
+    {
+      bigmulmn (t, (unsigned *)&b[nb0], eb, (unsigned *)a, na0, eb + na0);
+      (void)kd_div_add_into (&w[nb0], na + nb - nb0, t, eb + na0);
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Sizes, in words, below which the recursive algorithms below hand over
+ * to the schoolbook ones: divmnu_bz() uses kd_div_knuth() for divisors
+ * (and recursive subproblems) shorter than kd_div_bz_threshold, and
+ * kd_div_karatsuba() uses bigmulmn() for factors shorter than
+ * kd_div_karatsuba_threshold.  "divmnu -b bz" shows where the
+ * crossover lies on a given machine, and "make tune" sets both.
+ */
+
+#ifndef KD_DIV_BZ_THRESHOLD
+# define KD_DIV_BZ_THRESHOLD 256
+#endif /* ifndef KD_DIV_BZ_THRESHOLD */
+
+#ifndef KD_DIV_KARATSUBA_THRESHOLD
+# define KD_DIV_KARATSUBA_THRESHOLD 32
+#endif /* ifndef KD_DIV_KARATSUBA_THRESHOLD */
+
+KD_DIV_LOCAL int kd_div_bz_threshold        = KD_DIV_BZ_THRESHOLD;
+KD_DIV_LOCAL int kd_div_karatsuba_threshold = KD_DIV_KARATSUBA_THRESHOLD;
+
+/****************************************************************************/
+
+/*
+ * Words of scratch space needed by kd_div_karatsuba() for n-word
+ * factors.
+ */
+
+KD_DIV_LOCAL int
+kd_div_karatsuba_scratch (int n);
+
+KD_DIV_LOCAL int
+kd_div_karatsuba_scratch (int n)
+{
+  if (n < kd_div_karatsuba_threshold || n < 4)
+    return n + 1;
+
+  if (n >= kd_div_ntt_threshold && 2 * n <= KD_DIV_NTT_MAX)
+    return kd_div_ntt_scratch (2 * n);
+
+  int h  = n / 2;
+  int hh = n - h;
+  int s0 = kd_div_karatsuba_scratch (h);
+  int s2 = kd_div_karatsuba_scratch (hh);
+  int s1 = 4 * (hh + 1) + kd_div_karatsuba_scratch (hh + 1);
+
+  return s0 > s2 ? (s0 > s1 ? s0 : s1) : (s2 > s1 ? s2 : s1);
+}
+
+/****************************************************************************/
+
+/*
+ * w = a * b, for a and b of n words and w of 2n words, by Karatsuba's
+ * method: with a = a1 * B + a0 and b = b1 * B + b0, B = b**(n/2),
+ *
+ *   a * b = a1 b1 B**2 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) B + a0 b0,
+ *
+ * three half-size products instead of four.  ws is scratch space of
+ * kd_div_karatsuba_scratch(n) words; w must not overlap a, b or ws.
+ */
+
+KD_DIV_LOCAL void
+kd_div_karatsuba (unsigned w[], const unsigned a[], const unsigned b[],
+                  int n, unsigned ws[]);
+
+KD_DIV_LOCAL void
+kd_div_karatsuba (unsigned w[], const unsigned a[], const unsigned b[],
+                  int n, unsigned ws[])
+{
+  if (n < kd_div_karatsuba_threshold || n < 4)
+    {
+      bigmulmn (w, (unsigned *)a, n, (unsigned *)b, n, 2 * n);
+      return;
+    }
+
+  if (n >= kd_div_ntt_threshold && 2 * n <= KD_DIV_NTT_MAX)
+    {
+      kd_div_ntt_mul_fit (w, a, n, b, n, ws);
+      return;
+    }
+
+  int h  = n / 2;
+  int hh = n - h;
+
+  /* a0 b0 and a1 b1 go straight to their places in w. */
+
+  kd_div_karatsuba (w, a, b, h, ws);
+  kd_div_karatsuba (&w[2 * h], &a[h], &b[h], hh, ws);
+
+  unsigned *sa = ws;                         /* a0 + a1, hh + 1 words    */
+  unsigned *sb = &sa[hh + 1];                /* b0 + b1, hh + 1 words    */
+  unsigned *z1 = &sb[hh + 1];                /* 2hh + 2 words            */
+
+  for (int i = 0; i < hh; i++)
+    {
+      sa[i] = a[h + i];
+      sb[i] = b[h + i];
+    }
+
+  sa[hh] = kd_div_add_into (sa, hh, a, h);
+  sb[hh] = kd_div_add_into (sb, hh, b, h);
+
+  kd_div_karatsuba (z1, sa, sb, hh + 1, &z1[2 * hh + 2]);
+
+  (void)kd_div_sub_from (z1, 2 * hh + 2, w, 2 * h);
+  (void)kd_div_sub_from (z1, 2 * hh + 2, &w[2 * h], 2 * hh);
+  (void)kd_div_add_into (&w[h], 2 * n - h, z1, 2 * hh + 2);
+}
+
+/****************************************************************************/
+
+KD_DIV_LOCAL int
+kd_div_bz_scratch (int n);
+
+KD_DIV_LOCAL int
+kd_div_bz_scratch_3n2n (int h);
+
+/*
+ * Words of scratch space needed by kd_div_bz_2n1n() for an n-word
+ * divisor, and by kd_div_bz_3n2n() for a 2h-word divisor.
+ */
+
+KD_DIV_LOCAL int
+kd_div_bz_scratch (int n)
+{
+  if (n < kd_div_bz_threshold || n < 2)
+    return n + 1;
+
+  if (n % 2 != 0)
+    return 5 * n + 5 + kd_div_bz_scratch (n + 1);
+
+  return 3 * (n / 2) + kd_div_bz_scratch_3n2n (n / 2);
+}
+
+KD_DIV_LOCAL int
+kd_div_bz_scratch_3n2n (int h)
+{
+  int s2 = kd_div_bz_scratch (h);
+  int sk = kd_div_karatsuba_scratch (h);
+
+  return 5 * h + 2 + (s2 > sk ? s2 : sk);
+}
+
+/****************************************************************************/
+
+KD_DIV_LOCAL void
+kd_div_bz_2n1n (unsigned q[], unsigned r[], const unsigned a[],
+                const unsigned b[], int n, unsigned ws[]);
+
+/*
+ * Burnikel-Ziegler 3n/2n step: q = a / b and r = a mod b for a of 3h
+ * words, b of 2h words with its top bit set, and a < b * b**h, so that
+ * q fits h words.  q is estimated from the top 2h words of a and the
+ * top h words of b with kd_div_bz_2n1n(), which is at most two too
+ * large, and corrected while the remainder is negative.
+ */
+
+KD_DIV_LOCAL void
+kd_div_bz_3n2n (unsigned q[], unsigned r[], const unsigned a[],
+                const unsigned b[], int h, unsigned ws[]);
+
+KD_DIV_LOCAL void
+kd_div_bz_3n2n (unsigned q[], unsigned r[], const unsigned a[],
+                const unsigned b[], int h, unsigned ws[])
+{
+  const unsigned *b1 = &b[h];
+  unsigned *r1       = ws;                   /* h + 1 words              */
+  unsigned *x        = &r1[h + 1];           /* 2h + 1 words             */
+  unsigned *d        = &x[2 * h + 1];        /* 2h words                 */
+  unsigned *rest     = &d[2 * h];
+  int i              = h - 1;
+
+  while (i > 0 && a[2 * h + i] == b1[i])
+    i--;
+
+  if (a[2 * h + i] < b1[i])
+    {
+      /* q = [a2 a1] / b1, r1 = [a2 a1] mod b1. */
+
+      kd_div_bz_2n1n (q, r1, &a[h], b1, h, rest);
+      r1[h] = 0;
+    }
+  else
+    {
+      /* a2 == b1: q = b**h - 1, r1 = [a2 a1] - q * b1 = a1 + b1. */
+
+      for (i = 0; i < h; i++)
+        {
+          q[i]  = UINT32_MAX;
+          r1[i] = a[h + i];
+        }
+
+      r1[h] = kd_div_add_into (r1, h, b1, h);
+    }
+
+  /* x = r1 * b**h + a0 - q * b0. */
+
+  for (i = 0; i < h; i++)
+    x[i] = a[i];
+
+  for (i = 0; i <= h; i++)
+    x[h + i] = r1[i];
+
+  kd_div_karatsuba (d, q, b, h, rest);
+
+  bool negative = kd_div_sub_from (x, 2 * h + 1, d, 2 * h);
+
+  while (negative)
+    {
+      for (i = 0; q[i]-- == 0; i++)
+        ;
+
+      negative = !kd_div_add_into (x, 2 * h + 1, b, 2 * h);
+    }
+
+  for (i = 0; i < 2 * h; i++)
+    r[i] = x[i];
+}
+
+/****************************************************************************/
+
+/*
+ * Burnikel-Ziegler 2n/1n step: q = a / b and r = a mod b for a of 2n
+ * words, b of n words with its top bit set, and a < b * b**n, so that
+ * q fits n words.  Even n splits into two 3n/2n steps on halves; odd n
+ * is made even by multiplying a and b by b; and below
+ * kd_div_bz_threshold, kd_div_knuth() does the work.  ws is scratch
+ * space of kd_div_bz_scratch(n) words.
+ */
+
+KD_DIV_LOCAL void
+kd_div_bz_2n1n (unsigned q[], unsigned r[], const unsigned a[],
+                const unsigned b[], int n, unsigned ws[])
+{
+  if (n < kd_div_bz_threshold || n < 2)
+    {
+      (void)kd_div_knuth (ws, r, a, b, 2 * n, n);
+
+      for (int i = 0; i < n; i++)
+        q[i] = ws[i];
+
+      return;
+    }
+
+  if (n % 2 != 0)
+    {
+      unsigned *ap   = ws;                   /* 2n + 2 words             */
+      unsigned *bp   = &ap[2 * n + 2];       /* n + 1 words              */
+      unsigned *qp   = &bp[n + 1];           /* n + 1 words              */
+      unsigned *rp   = &qp[n + 1];           /* n + 1 words              */
+      unsigned *rest = &rp[n + 1];
+
+      ap[0]         = 0;
+      ap[2 * n + 1] = 0;
+      bp[0]         = 0;
+
+      for (int i = 0; i < 2 * n; i++)
+        ap[i + 1] = a[i];
+
+      for (int i = 0; i < n; i++)
+        bp[i + 1] = b[i];
+
+      kd_div_bz_2n1n (qp, rp, ap, bp, n + 1, rest);
+
+      for (int i = 0; i < n; i++)
+        {
+          q[i] = qp[i];
+          r[i] = rp[i + 1];
+        }
+
+      return;
+    }
+
+  /* [a3 a2 a1] / b, then [r a0] / b. */
+
+  int h       = n / 2;
+  unsigned *t = ws;                          /* 3h words: a0, then r     */
+
+  for (int i = 0; i < h; i++)
+    t[i] = a[i];
+
+  kd_div_bz_3n2n (&q[h], &t[h], &a[h], b, h, &t[3 * h]);
+  kd_div_bz_3n2n (q, r, t, b, h, &t[3 * h]);
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu(), by Burnikel and Ziegler's recursive division ("Fast
+ * Recursive Division", MPI-I-98-1-022): the normalized dividend is
+ * divided by the normalized divisor n words at a time with
+ * kd_div_bz_2n1n(), whose multiplications are done by
+ * kd_div_karatsuba(), for O(n**1.58 * (m / n)) work instead of
+ * O((m - n) * n).  Divisors shorter than kd_div_bz_threshold words go
+ * straight to kd_div_knuth().  Returns 0 for success, 1 for invalid
+ * parameters and 2 if out of memory.
+ */
+
+int
+divmnu_bz (unsigned q[], unsigned r[], const unsigned u[],
+           const unsigned v[], int m, int n);
+
+int
+divmnu_bz (unsigned q[], unsigned r[], const unsigned u[],
+           const unsigned v[], int m, int n)
+{
+  if (m < n || n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  if (n < kd_div_bz_threshold || n < 2)
+    return kd_div_knuth (q, r, u, v, m, n);
+
+  /*
+   * un has m + 1 words: a top part of k words, n <= k < 2n, and j blocks
+   * of n words below it.
+   */
+
+  int j  = (m + 1 - n) / n;
+  int k  = m + 1 - j * n;
+  int nw = 2 * m + 4 * n + 3 + kd_div_bz_scratch (n);
+  unsigned *un = calloc ( (size_t)nw, sizeof (unsigned) );
+
+  if (un == NULL)
+    return 2;
+
+  unsigned *qf  = &un[m + 1];                /* m - n + 2 words          */
+  unsigned *vn  = &qf[m - n + 2];            /* n words                  */
+  unsigned *a   = &vn[n];                    /* 2n words                 */
+  unsigned *rem = &a[2 * n];                 /* n words                  */
+  unsigned *ws  = &rem[n];
+  int s         = nlz (v[n - 1]);
+
+  /* Normalize as in divmnu(); here s == 0 needs no special case. */
+
+  for (int i = n - 1; i > 0; i--)
+    vn[i] = v[i] << s | (unsigned)( (uint64_t)v[i - 1] >> (32 - s) );
+
+  vn[0] = v[0] << s;
+
+  un[m] = (unsigned)( (uint64_t)u[m - 1] >> (32 - s) );
+
+  for (int i = m - 1; i > 0; i--)
+    un[i] = u[i] << s | (unsigned)( (uint64_t)u[i - 1] >> (32 - s) );
+
+  un[0] = u[0] << s;
+
+  /*
+   * Long division in base b**n: the top part, with a quotient of at
+   * most n words, by kd_div_knuth(), then each block below it, together
+   * with the remainder so far, by kd_div_bz_2n1n().
+   */
+
+  (void)kd_div_knuth (&qf[j * n], rem, &un[j * n], vn, k, n);
+
+  while (--j >= 0)
+    {
+      for (int i = 0; i < n; i++)
+        {
+          a[i]     = un[j * n + i];
+          a[n + i] = rem[i];
+        }
+
+      kd_div_bz_2n1n (&qf[j * n], rem, a, vn, n, ws);
+    }
+
+  for (int i = 0; i <= m - n; i++)
+    q[i] = qf[i];
+
+  if (r != NULL)
+    {
+      for (int i = 0; i < n - 1; i++)
+        r[i] = rem[i] >> s | (unsigned)( (uint64_t)rem[i + 1] << (32 - s) );
+
+      r[n - 1] = rem[n - 1] >> s;
+    }
+
+  free (un);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Sizes, in words, from which divmnu_auto() uses divmnu_newton(): both
+ * the divisor and the quotient must be at least this long.  "make
+ * tune" sets it.
+ */
+
+#ifndef KD_DIV_NEWTON_THRESHOLD
+# define KD_DIV_NEWTON_THRESHOLD 16384
+#endif /* ifndef KD_DIV_NEWTON_THRESHOLD */
+
+KD_DIV_LOCAL int kd_div_newton_threshold = KD_DIV_NEWTON_THRESHOLD;
+
+/****************************************************************************/
+
+/*
+ * Words of scratch space needed by kd_div_mul() for factors of na and
+ * nb words.
+ */
+
+KD_DIV_LOCAL int
+kd_div_mul_scratch (int na, int nb);
+
+KD_DIV_LOCAL int
+kd_div_mul_scratch (int na, int nb)
+{
+  if (na < nb)
+    return kd_div_mul_scratch (nb, na);
+
+  if (nb < kd_div_karatsuba_threshold)
+    return nb + 1;
+
+  if (nb >= kd_div_ntt_threshold && na + nb <= KD_DIV_NTT_MAX)
+    return kd_div_ntt_scratch (na + nb);
+
+  int c  = na % nb;
+  int sk = kd_div_karatsuba_scratch (nb);
+  int sc = c > 0 ? kd_div_mul_scratch (nb, c) : 0;
+
+  return 2 * nb + (sk > sc ? sk : sc);
+}
+
+/****************************************************************************/
+
+/*
+ * w = a * b, for a of na words, b of nb words and w of na + nb words.
+ * The longer factor is cut into pieces as long as the shorter one, which
+ * are multiplied with kd_div_karatsuba() and added into place; a short
+ * last piece is done the same way with the roles swapped.  ws is scratch
+ * space of kd_div_mul_scratch(na, nb) words; w must not overlap a, b or
+ * ws.
+ */
+
+KD_DIV_LOCAL void
+kd_div_mul (unsigned w[], const unsigned a[], int na, const unsigned b[],
+            int nb, unsigned ws[]);
+
+KD_DIV_LOCAL void
+kd_div_mul (unsigned w[], const unsigned a[], int na, const unsigned b[],
+            int nb, unsigned ws[])
+{
+  if (na < nb)
+    {
+      kd_div_mul (w, b, nb, a, na, ws);
+      return;
+    }
+
+  if (nb < kd_div_karatsuba_threshold)
+    {
+      bigmulmn (w, (unsigned *)a, na, (unsigned *)b, nb, na + nb);
+      return;
+    }
+
+  if (nb >= kd_div_ntt_threshold && na + nb <= KD_DIV_NTT_MAX)
+    {
+      kd_div_ntt_mul_fit (w, a, na, b, nb, ws);
+      return;
+    }
+
+  unsigned *t    = ws;                       /* 2nb words                */
+  unsigned *rest = &t[2 * nb];
+  int i;
+
+  for (i = 0; i < na + nb; i++)
+    w[i] = 0;
+
+  for (i = 0; i + nb <= na; i += nb)
+    {
+      kd_div_karatsuba (t, &a[i], b, nb, rest);
+      (void)kd_div_add_into (&w[i], na + nb - i, t, 2 * nb);
+    }
+
+  if (i < na)
+    {
+      kd_div_mul (t, b, nb, &a[i], na - i, rest);
+      (void)kd_div_add_into (&w[i], na + nb - i, t, nb + na - i);
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Words of scratch space needed by kd_div_reciprocal() for an n-word
+ * divisor.
+ */
+
+KD_DIV_LOCAL int
+kd_div_reciprocal_scratch (int n);
+
+KD_DIV_LOCAL int
+kd_div_reciprocal_scratch (int n)
+{
+  if (n <= 2 || n < kd_div_bz_threshold)
+    return 4 * n + 3;
+
+  int l  = (n - 1) / 2;
+  int h  = n - l;
+  int sr = kd_div_reciprocal_scratch (h);
+  int s1 = kd_div_mul_scratch (n, h + 1);
+  int s2 = kd_div_mul_scratch (h + 1, h + 1);
+  int s  = sr > s1 ? (sr > s2 ? sr : s2) : (s1 > s2 ? s1 : s2);
+
+  return (h + 1) + (n + h + 1) + (2 * h + 2) + s;
+}
+
+/****************************************************************************/
+
+/*
+ * x = an approximate reciprocal of a, for a of n words with its top bit
+ * set: a * x < b**(2n) <= a * (x + 2), so b**n < x < 2 b**n and x has
+ * n + 1 words.  Newton's iteration, as in Brent and Zimmermann, "Modern
+ * Computer Arithmetic", Algorithm 3.5: a reciprocal xh of the top half
+ * of a is corrected by xh * (b**(n+h) - a * xh), which doubles the
+ * number of correct words at each level of the recursion.  Below
+ * kd_div_bz_threshold the reciprocal is found by division.  ws is
+ * scratch space of kd_div_reciprocal_scratch(n) words.
+ */
+
+KD_DIV_LOCAL void
+kd_div_reciprocal (unsigned x[], const unsigned a[], int n, unsigned ws[]);
+
+KD_DIV_LOCAL void
+kd_div_reciprocal (unsigned x[], const unsigned a[], int n, unsigned ws[])
+{
+  if (n <= 2 || n < kd_div_bz_threshold)
+    {
+      unsigned *p  = ws;                     /* 2n + 1 words             */
+      unsigned *rr = &p[2 * n + 1];          /* n words                  */
+      unsigned *qq = &rr[n];                 /* n + 2 words              */
+      bool exact   = true;
+      int i;
+
+      /* x = ceil(b**(2n) / a) - 1. */
+
+      for (i = 0; i < 2 * n; i++)
+        p[i] = 0;
+
+      p[2 * n] = 1;
+
+      (void)divmnu_bz (qq, rr, p, a, 2 * n + 1, n);
+
+      for (i = 0; i < n; i++)
+        exact = exact && rr[i] == 0;
+
+      if (exact)
+        for (i = 0; qq[i]-- == 0; i++)
+          ;
+
+      for (i = 0; i <= n; i++)
+        x[i] = qq[i];
+
+      return;
+    }
+
+  int l          = (n - 1) / 2;
+  int h          = n - l;
+  unsigned *xh   = ws;                       /* h + 1 words              */
+  unsigned *t    = &xh[h + 1];               /* n + h + 1 words          */
+  unsigned *u    = &t[n + h + 1];            /* 2h + 2 words             */
+  unsigned *rest = &u[2 * h + 2];
+  int i;
+
+  kd_div_reciprocal (xh, &a[l], h, rest);
+
+  /* t = a * xh, brought below b**(n+h). */
+
+  kd_div_mul (t, a, n, xh, h + 1, rest);
+
+  while (t[n + h] != 0)
+    {
+      for (i = 0; xh[i]-- == 0; i++)
+        ;
+
+      (void)kd_div_sub_from (t, n + h + 1, a, n);
+    }
+
+  /* t = b**(n+h) - t, which is less than 2a. */
+
+  for (i = 0; i < n + h; i++)
+    t[i] = ~t[i];
+
+  t[n + h] = 0;
+
+  for (i = 0; ++t[i] == 0; i++)
+    ;
+
+  /* x = xh * b**l + floor(floor(t / b**l) * xh / b**(2h - l)). */
+
+  kd_div_mul (u, &t[l], h + 1, xh, h + 1, rest);
+
+  for (i = 0; i < l; i++)
+    x[i] = 0;
+
+  for (i = 0; i <= h; i++)
+    x[l + i] = xh[i];
+
+  (void)kd_div_add_into (x, n + 1, &u[2 * h - l], l + 2);
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu(), by multiplication with a reciprocal of v.  With
+ * lq = m - n + 1 quotient words, lq + 1 words of the normalized divisor
+ * (its top words, or v followed by zero words if v is shorter) are
+ * enough to determine the quotient to within a few units;
+ * kd_div_reciprocal() inverts them, one multiplication by the matching
+ * top of u gives the estimate, and the remainder u - q * v, corrected
+ * with bigadd() and bigsub() while it is negative or not below v,
+ * brings the quotient to its exact value.  All products are done by
+ * kd_div_mul(), so this pays off once those are well inside Karatsuba
+ * range.  Returns 0 for success, 1 for invalid parameters and 2 if out
+ * of memory.
+ */
+
+int
+divmnu_newton (unsigned q[], unsigned r[], const unsigned u[],
+               const unsigned v[], int m, int n);
+
+int
+divmnu_newton (unsigned q[], unsigned r[], const unsigned u[],
+               const unsigned v[], int m, int n)
+{
+  if (m < n || n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  const int lq = m - n + 1;
+  const int k  = lq + 1;                     /* Words of divisor used.   */
+  const int d  = n - k;                      /* Shift of them, in words. */
+  const int s  = nlz (v[n - 1]);
+
+  int s1 = kd_div_reciprocal_scratch (k);
+  int s2 = kd_div_mul_scratch (lq + 1, k + 1);
+  int s3 = kd_div_mul_scratch (lq + 1, n);
+  int sw = s1 > s2 ? (s1 > s3 ? s1 : s3) : (s2 > s3 ? s2 : s3);
+  int nw = k + (lq + k) + (k + 1) + (lq + 2 * k + 1) + (lq + 1) +
+             5 * (m + 2) + sw;
+
+  unsigned *vt = calloc ( (size_t)nw, sizeof (unsigned) );
+
+  if (vt == NULL)
+    return 2;
+
+  unsigned *ut = &vt[k];                     /* lq + k words             */
+  unsigned *x  = &ut[lq + k];                /* k + 1 words              */
+  unsigned *p  = &x[k + 1];                  /* lq + 2k + 1 words        */
+  unsigned *qe = &p[lq + 2 * k + 1];         /* lq + 1 words             */
+  unsigned *pv = &qe[lq + 1];                /* m + 2 words each:        */
+  unsigned *up = &pv[m + 2];                 /*   q * v, u, v, r and a   */
+  unsigned *vp = &up[m + 2];                 /*   trial remainder        */
+  unsigned *rr = &vp[m + 2];
+  unsigned *tt = &rr[m + 2];
+  unsigned *ws = &tt[m + 2];
+  int i;
+
+  /*
+   * vt and ut: words d .. d + k - 1 of the normalized divisor, and words
+   * d .. m of the normalized dividend, with words below 0 taken as 0.
+   */
+
+  for (i = 0; i < k; i++)
+    {
+      int j = i + d;
+
+      if (j >= 0)
+        vt[i] = v[j] << s |
+                  (j > 0 ? (unsigned)( (uint64_t)v[j - 1] >> (32 - s) ) : 0);
+    }
+
+  for (i = 0; i < lq + k; i++)
+    {
+      int j = i + d;
+
+      if (j >= 0)
+        ut[i] = (j < m ? u[j] << s : 0) |
+                  (j > 0 ? (unsigned)( (uint64_t)u[j - 1] >> (32 - s) ) : 0);
+    }
+
+  /*
+   * qe = floor(floor(ut / b**(k-1)) * x / b**(k+1)), at most a few
+   * units from q: the low k - 1 words of ut would add less than one to
+   * it, so they are left out of the product.
+   */
+
+  kd_div_reciprocal (x, vt, k, ws);
+  kd_div_mul (p, &ut[k - 1], lq + 1, x, k + 1, ws);
+
+  for (i = 0; i <= lq; i++)
+    qe[i] = p[k + 1 + i];
+
+  /* rr = u - qe * v, over m + 2 words. */
+
+  kd_div_mul (pv, qe, lq + 1, v, n, ws);
+
+  for (i = 0; i < m; i++)
+    up[i] = u[i];
+
+  for (i = 0; i < n; i++)
+    vp[i] = v[i];
+
+  bool negative = !bigsub (rr, pv, up, 0, m + 1, true);
+
+  while (negative)
+    {
+      for (i = 0; qe[i]-- == 0; i++)
+        ;
+
+      negative = !bigadd (rr, vp, rr, 0, m + 1, 0);
+    }
+
+  while (bigsub (tt, vp, rr, 0, m + 1, true))
+    {
+      for (i = 0; ++qe[i] == 0; i++)
+        ;
+
+      unsigned *swap = rr;
+      rr             = tt;
+      tt             = swap;
+    }
+
+  for (i = 0; i < lq; i++)
+    q[i] = qe[i];
+
+  if (r != NULL)
+    for (i = 0; i < n; i++)
+      r[i] = rr[i];
+
+  free (vt);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Same as divmnu(), with the algorithm chosen by size: divmnu_newton()
+ * when both the divisor and the quotient have at least
+ * kd_div_newton_threshold words, otherwise divmnu_bz(), which itself
+ * goes to kd_div_knuth() below kd_div_bz_threshold.
+ */
+
+int
+divmnu_auto (unsigned q[], unsigned r[], const unsigned u[],
+             const unsigned v[], int m, int n);
+
+int
+divmnu_auto (unsigned q[], unsigned r[], const unsigned u[],
+             const unsigned v[], int m, int n)
+{
+  if (n >= kd_div_newton_threshold && m - n + 1 >= kd_div_newton_threshold)
+    return divmnu_newton (q, r, u, v, m, n);
+
+  return divmnu_bz (q, r, u, v, m, n);
+}
+
+/****************************************************************************/
+
+/*
+ * Batched division of count independent problems of the same size (m,
+ * n), in lane-interleaved (structure-of-arrays) order: word i of the
+ * k-th dividend is u[i * count + k], and likewise for v, q (m - n + 1
+ * words per problem) and r (n words per problem, optional).
+ *
+ * On x86 processors with AVX2, groups of four problems are carried
+ * through normalization, quotient digit estimation (by the reciprocal
+ * method of divrem_64_by_32_preinv()), multiply-and-subtract, add-back
+ * and unnormalization together, one problem per 64-bit vector lane.
+ * Problems left over, batches with n == 1, and other processors use
+ * divmnu() one problem at a time.  Either way the results are the same
+ * as those of divmnu().
+ *
+ * Returns 0 for success, 1 for invalid parameters (including a zero
+ * leading divisor word in any of the problems, in which case nothing
+ * is computed) and 2 if out of memory.
+ */
+
+/*
+ * Scalar path of divmnu_batch(): problems first to first + nlanes - 1.
+ */
+
+KD_DIV_LOCAL void
+divmnu_batch_scalar (unsigned q[], unsigned r[], const unsigned u[],
+                     const unsigned v[], int m, int n, int count,
+                     int first, int nlanes, unsigned scratch[]);
+
+KD_DIV_LOCAL void
+divmnu_batch_scalar (unsigned q[], unsigned r[], const unsigned u[],
+                     const unsigned v[], int m, int n, int count,
+                     int first, int nlanes, unsigned scratch[])
+{
+  unsigned *uk = scratch;
+  unsigned *vk = uk + m;
+  unsigned *qk = vk + n;
+  unsigned *rk = qk + (m - n + 1);
+
+  for (int k = first; k < first + nlanes; k++)
+    {
+      for (int i = 0; i < m; i++)
+        uk[i] = u[i * count + k];
+
+      for (int i = 0; i < n; i++)
+        vk[i] = v[i * count + k];
+
+      (void)divmnu (qk, r != NULL ? rk : NULL, uk, vk, m, n);
+
+      for (int i = 0; i <= m - n; i++)
+        q[i * count + k] = qk[i];
+
+      if (r != NULL)
+        for (int i = 0; i < n; i++)
+          r[i * count + k] = rk[i];
+    }
+}
+
+/****************************************************************************/
+
+#ifdef KD_DIV_HAVE_AVX2
+
+/*
+ * AVX2 path of divmnu_batch(): four problems, first to first + 3, with
+ * n >= 2.  Every 32-bit word is held zero-extended in a 64-bit lane;
+ * un is (m + 1) * 4 and vn is n * 4 64-bit words of scratch.
+ */
+
+__attribute__ ( (target ("avx2")) )
+KD_DIV_LOCAL void
+divmnu_batch_avx2 (unsigned q[], unsigned r[], const unsigned u[],
+                   const unsigned v[], int m, int n, int count, int first,
+                   uint64_t un[], uint64_t vn[]);
+
+__attribute__ ( (target ("avx2")) )
+KD_DIV_LOCAL void
+divmnu_batch_avx2 (unsigned q[], unsigned r[], const unsigned u[],
+                   const unsigned v[], int m, int n, int count, int first,
+                   uint64_t un[], uint64_t vn[])
+{
+#define LOAD4(p)      _mm256_cvtepu32_epi64 (                                \
+                        _mm_loadu_si128 ( (const __m128i *)(p) ) )
+#define LD(a, i)      _mm256_loadu_si256 ( (const __m256i *)&(a)[4 * (i)] )
+#define ST(a, i, x)   _mm256_storeu_si256 ( (__m256i *)&(a)[4 * (i)], (x) )
+#define STORE4(p, x)  _mm_storeu_si128 ( (__m128i *)(p),                     \
+                        _mm256_castsi256_si128 (                             \
+                          _mm256_permutevar8x32_epi32 ( (x), pack ) ) )
+#define GTU(a, b)     _mm256_cmpgt_epi64 (                                   \
+                        _mm256_xor_si256 ( (a), sign ),                      \
+                        _mm256_xor_si256 ( (b), sign ) )
+
+  const __m256i lo32 = _mm256_set1_epi64x (0xFFFFFFFFLL);
+  const __m256i one  = _mm256_set1_epi64x (1);
+  const __m256i sign = _mm256_set1_epi64x (INT64_MIN);
+  const __m256i b    = _mm256_set1_epi64x (1LL << 32);
+  const __m256i pack = _mm256_setr_epi32 (0, 2, 4, 6, 0, 0, 0, 0);
+  uint64_t sh[4], dinv[4];
+  int i, j;
+
+  /* Per-lane normalization shift, as in divmnu(). */
+
+  for (int k = 0; k < 4; k++)
+    sh[k] = (uint64_t)nlz (v[(n - 1) * count + first + k]);
+
+  const __m256i s   = LD (sh, 0);
+  const __m256i s32 = _mm256_sub_epi64 (_mm256_set1_epi64x (32), s);
+
+  /* Normalize v and u, all four lanes at once. */
+
+  __m256i prev = LOAD4 (&v[first]);
+
+  ST (vn, 0, _mm256_and_si256 (_mm256_sllv_epi64 (prev, s), lo32));
+
+  for (i = 1; i < n; i++)
+    {
+      __m256i cur = LOAD4 (&v[i * count + first]);
+
+      ST (vn, i, _mm256_and_si256 (
+                   _mm256_or_si256 (_mm256_sllv_epi64 (cur, s),
+                                    _mm256_srlv_epi64 (prev, s32) ),
+                   lo32) );
+      prev = cur;
+    }
+
+  prev = LOAD4 (&u[first]);
+
+  ST (un, 0, _mm256_and_si256 (_mm256_sllv_epi64 (prev, s), lo32));
+
+  for (i = 1; i < m; i++)
+    {
+      __m256i cur = LOAD4 (&u[i * count + first]);
+
+      ST (un, i, _mm256_and_si256 (
+                   _mm256_or_si256 (_mm256_sllv_epi64 (cur, s),
+                                    _mm256_srlv_epi64 (prev, s32) ),
+                   lo32) );
+      prev = cur;
+    }
+
+  ST (un, m, _mm256_srlv_epi64 (prev, s32));
+
+  /* Reciprocal of the top divisor digit of each lane. */
+
+  for (int k = 0; k < 4; k++)
+    dinv[k] = reciprocal_word ( (uint32_t)vn[4 * (n - 1) + k] );
+
+  const __m256i d    = LD (vn, n - 1);
+  const __m256i d2   = LD (vn, n - 2);
+  const __m256i vinv = LD (dinv, 0);
+
+  for (j = m - n; j >= 0; j--)
+    {
+      __m256i n1 = LD (un, j + n);
+      __m256i n0 = LD (un, j + n - 1);
+
+      /* qhat and rhat from the top two digits, as in the preinv path. */
+
+      __m256i dig2 = _mm256_or_si256 (_mm256_slli_epi64 (n1, 32), n0);
+      __m256i qq   = _mm256_add_epi64 (_mm256_mul_epu32 (vinv, n1), dig2);
+      __m256i q1   = _mm256_and_si256 (
+                       _mm256_add_epi64 (_mm256_srli_epi64 (qq, 32), one),
+                       lo32);
+      __m256i q0   = _mm256_and_si256 (qq, lo32);
+      __m256i rr   = _mm256_and_si256 (
+                       _mm256_sub_epi64 (n0, _mm256_mul_epu32 (q1, d)),
+                       lo32);
+      __m256i fix  = _mm256_cmpgt_epi64 (rr, q0);
+
+      q1 = _mm256_and_si256 (_mm256_add_epi64 (q1, fix), lo32);
+      rr = _mm256_and_si256 (
+             _mm256_add_epi64 (rr, _mm256_and_si256 (fix, d)), lo32);
+      fix = _mm256_andnot_si256 (_mm256_cmpgt_epi64 (d, rr),
+                                 _mm256_set1_epi64x (-1));
+      q1  = _mm256_sub_epi64 (q1, fix);
+      rr  = _mm256_sub_epi64 (rr, _mm256_and_si256 (fix, d));
+
+      /* Overflow (un[j+n] == vn[n-1]): qhat = b - 1, rhat can be >= b. */
+
+      __m256i ovf  = _mm256_andnot_si256 (_mm256_cmpgt_epi64 (d, n1),
+                                          _mm256_set1_epi64x (-1));
+      __m256i qhat = _mm256_blendv_epi8 (q1, lo32, ovf);
+      __m256i rhat = _mm256_blendv_epi8 (
+                       rr,
+                       _mm256_sub_epi64 (dig2, _mm256_mul_epu32 (lo32, d)),
+                       ovf);
+
+      /* Use 3rd-from-top digit to obtain better accuracy (at most 2x). */
+
+      __m256i n2 = LD (un, j + n - 2);
+
+      for (int again = 0; again < 2; again++)
+        {
+          __m256i small = GTU (b, rhat);
+          __m256i lhs   = _mm256_mul_epu32 (qhat, d2);
+          __m256i rhs   = _mm256_add_epi64 (_mm256_slli_epi64 (rhat, 32),
+                                            n2);
+          __m256i dec   = _mm256_and_si256 (small, GTU (lhs, rhs));
+
+          if (_mm256_testz_si256 (dec, dec))
+            break;
+
+          qhat = _mm256_add_epi64 (qhat, dec);
+          rhat = _mm256_add_epi64 (rhat, _mm256_and_si256 (dec, d));
+        }
+
+      /* Multiply and subtract. */
+
+      __m256i carry  = _mm256_setzero_si256 ();
+      __m256i borrow = _mm256_setzero_si256 ();
+
+      for (i = 0; i < n; i++)
+        {
+          __m256i p = _mm256_add_epi64 (_mm256_mul_epu32 (qhat, LD (vn, i)),
+                                        carry);
+          __m256i t = _mm256_sub_epi64 (
+                        _mm256_sub_epi64 (LD (un, i + j),
+                                          _mm256_and_si256 (p, lo32) ),
+                        borrow);
+
+          ST (un, i + j, _mm256_and_si256 (t, lo32));
+          carry  = _mm256_srli_epi64 (p, 32);
+          borrow = _mm256_srli_epi64 (t, 63);
+        }
+
+      __m256i t = _mm256_sub_epi64 (
+                    _mm256_sub_epi64 (LD (un, j + n), carry), borrow);
+
+      ST (un, j + n, _mm256_and_si256 (t, lo32));
+
+      /* If we subtracted too much, add it back, lane by lane. */
+
+      __m256i need_fixup = _mm256_cmpgt_epi64 (_mm256_setzero_si256 (), t);
+
+      qhat = _mm256_add_epi64 (qhat, need_fixup);
+
+      if (!_mm256_testz_si256 (need_fixup, need_fixup))
+        {
+          __m256i c = _mm256_setzero_si256 ();
+
+          for (i = 0; i < n; i++)
+            {
+              __m256i x = _mm256_add_epi64 (
+                            _mm256_add_epi64 (
+                              LD (un, i + j),
+                              _mm256_and_si256 (need_fixup, LD (vn, i)) ),
+                            c);
+
+              ST (un, i + j, _mm256_and_si256 (x, lo32));
+              c = _mm256_and_si256 (need_fixup, _mm256_srli_epi64 (x, 32));
+            }
+
+          ST (un, j + n, _mm256_and_si256 (
+                           _mm256_add_epi64 (LD (un, j + n), c), lo32));
+        }
+
+      STORE4 (&q[j * count + first], qhat);
+    }
+
+  /* Unnormalize the remainder. */
+
+  if (r != NULL)
+    {
+      for (i = 0; i < n - 1; i++)
+        STORE4 (&r[i * count + first],
+                _mm256_and_si256 (
+                  _mm256_or_si256 (_mm256_srlv_epi64 (LD (un, i), s),
+                                   _mm256_sllv_epi64 (LD (un, i + 1), s32)),
+                  lo32) );
+
+      STORE4 (&r[(n - 1) * count + first],
+              _mm256_srlv_epi64 (LD (un, n - 1), s));
+    }
+
+#undef LOAD4
+#undef LD
+#undef ST
+#undef STORE4
+#undef GTU
+}
+
+#endif /* ifdef KD_DIV_HAVE_AVX2 */
+
+/****************************************************************************/
+
+int
+divmnu_batch (unsigned q[], unsigned r[], const unsigned u[],
+              const unsigned v[], int m, int n, int count);
+
+int
+divmnu_batch (unsigned q[], unsigned r[], const unsigned u[],
+              const unsigned v[], int m, int n, int count)
+{
+  int done = 0;
+
+  if (m < n || n <= 0 || count <= 0)
+    return 1;                                /* Return if invalid param. */
+
+  for (int k = 0; k < count; k++)
+    if (v[(n - 1) * count + k] == 0)
+      return 1;
+
+#ifdef KD_DIV_HAVE_AVX2
+  if (n >= 2 && count >= 4 && __builtin_cpu_supports ("avx2"))
+    {
+      uint64_t *un = malloc (sizeof (uint64_t) * 4 * (size_t)(m + 1 + n));
+
+      if (un == NULL)
+        return 2;
+
+      for (; done + 4 <= count; done += 4)
+        divmnu_batch_avx2 (q, r, u, v, m, n, count, done, un,
+                           un + 4 * (m + 1));
+
+      free (un);
+    }
+#endif /* ifdef KD_DIV_HAVE_AVX2 */
+
+  if (done < count)
+    {
+      unsigned *scratch = malloc (sizeof (unsigned) * (size_t)(2 * m + n + 1));
+
+      if (scratch == NULL)
+        return 2;
+
+      divmnu_batch_scalar (q, r, u, v, m, n, count, done, count - done,
+                           scratch);
+
+      free (scratch);
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+#ifndef KD_DIV_LIBRARY
+
+/****************************************************************************/
+
+/*
+ * Pseudo-random digits for the tests and benchmarks (xorshift64*),
+ * reproducible from run to run.
+ */
+
+uint64_t kd_div_seed = 0x9E3779B97F4A7C15ULL;
+
+uint32_t
+kd_div_random (void);
+
+uint32_t
+kd_div_random (void)
+{
+  kd_div_seed ^= kd_div_seed >> 12;
+  kd_div_seed ^= kd_div_seed << 25;
+  kd_div_seed ^= kd_div_seed >> 27;
+
+  return (uint32_t)( (kd_div_seed * 0x2545F4914F6CDD1DULL) >> 32 );
+}
+
+/****************************************************************************/
+
+/*
+ * Operand distributions for kd_div_generate(): uniformly random words;
+ * random words with the top three near 0xffffffff, which makes qhat
+ * estimates too large; mostly zero words, one in sixteen random; and
+ * random words with a divisor whose top word is 1.
+ */
+
+typedef enum
+{
+  KD_DIV_DIST_UNIFORM,
+  KD_DIV_DIST_HIGH,
+  KD_DIV_DIST_SPARSE,
+  KD_DIV_DIST_UNIT
+} kd_div_dist_t;
+
+const char *const kd_div_dist_names[] = {
+  [KD_DIV_DIST_UNIFORM] = "uniform",
+  [KD_DIV_DIST_HIGH]    = "high",
+  [KD_DIV_DIST_SPARSE]  = "sparse",
+  [KD_DIV_DIST_UNIT]    = "unit",
+};
+
+const int kd_div_ndists = sizeof (kd_div_dist_names) /
+                            sizeof (kd_div_dist_names[0]);
+
+/****************************************************************************/
+
+/*
+ * Fill w, of n words, with random words of distribution dist.
+ */
+
+void
+kd_div_fill (unsigned w[], int n, kd_div_dist_t dist);
+
+void
+kd_div_fill (unsigned w[], int n, kd_div_dist_t dist)
+{
+  for (int i = 0; i < n; i++)
+    if (dist == KD_DIV_DIST_HIGH && i >= n - 3)
+      w[i] = 0xffffffff - kd_div_random () % 4;
+    else if (dist == KD_DIV_DIST_SPARSE && kd_div_random () % 16 != 0)
+      w[i] = 0;
+    else
+      w[i] = kd_div_random ();
+}
+
+/****************************************************************************/
+
+/*
+ * u and v, of m and n words, from the seeded generator with distribution
+ * dist.  v[n-1] is never 0.
+ */
+
+void
+kd_div_generate (unsigned u[], int m, unsigned v[], int n,
+                 kd_div_dist_t dist);
+
+void
+kd_div_generate (unsigned u[], int m, unsigned v[], int n,
+                 kd_div_dist_t dist)
+{
+  kd_div_fill (u, m, dist);
+  kd_div_fill (v, n, dist);
+
+  if (dist == KD_DIV_DIST_UNIT)
+    v[n - 1] = 1;
+  else
+    while (v[n - 1] == 0)
+      v[n - 1] = kd_div_random ();
+}
+
+/****************************************************************************/
+
+/*
+ * Check the quotient q and remainder r of u / v, for u of m words and v
+ * of n words, by multiplying back: q * v + r, found with bigmulmn() and
+ * bigadd(), must be u, and r must be less than v.  ws is scratch space
+ * of 2m + n + 3 words.  Returns true if q and r are right.
+ */
+
+bool
+kd_div_verify (const unsigned q[], const unsigned r[], const unsigned u[],
+               const unsigned v[], int m, int n, unsigned ws[]);
+
+bool
+kd_div_verify (const unsigned q[], const unsigned r[], const unsigned u[],
+               const unsigned v[], int m, int n, unsigned ws[])
+{
+  unsigned *w   = ws;                        /* m + 1 words              */
+  unsigned *rp  = &w[m + 1];                 /* m + 1 words              */
+  unsigned *row = &rp[m + 1];                /* n + 1 words              */
+  int i;
+
+  bigmulmn (w, (unsigned *)q, m - n + 1, (unsigned *)v, n, m + 1);
+
+  for (i = 0; i <= m; i++)
+    rp[i] = i < n ? r[i] : 0;
+
+  if (bigadd (w, rp, w, 0, m, 0) || w[m] != 0)
+    return false;
+
+  for (i = 0; i < m; i++)
+    if (w[i] != u[i])
+      return false;
+
+  /* r < v exactly when r - v borrows. */
+
+  return !bigsub (row, (unsigned *)v, (unsigned *)r, 0, n - 1, true);
+}
+
+/****************************************************************************/
+
+/*
+ * Compare q and r with the expected cq and cr.  On pass l == 1 a
+ * mismatch is reported, and counted by returning 1; otherwise 0 is
+ * returned.
+ */
+
+int
+check (unsigned q[], unsigned r[], unsigned u[], unsigned v[], int m, int n,
+       unsigned cq[], unsigned cr[], long l);
+
+int
+check (unsigned q[], unsigned r[], unsigned u[], unsigned v[], int m, int n,
+       unsigned cq[], unsigned cr[], long l)
+{
+  int i, szq;
+
+  szq = kd_div_max (m - n + 1, 1);
+
+  for (i = 0; i < szq; i++)
+    {
+      if (q[i] != cq[i])
+        {
+          if (l == 1)
+            {
+              (void)fprintf (stderr, "\n\n");
+              dumpit ("FATAL ERROR: dividend u =", m, u);
+              dumpit ("             divisor  v =", n, v);
+              dumpit ("             remainder  =", m - n + 1, q);
+              dumpit ("             should be  =", m - n + 1, cq);
+              return 1;
+            }
+
+          return 0;
+        }
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      if (r[i] != cr[i])
+        {
+          if (l == 1)
+            {
+              (void)fprintf (stderr, "\n\n");
+              dumpit ("FATAL ERROR: dividend u =", m, u);
+              dumpit ("             divisor  v =", n, v);
+              dumpit ("             remainder  =", n, r);
+              dumpit ("             should be  =", n, cr);
+              return 1;
+            }
+
+          return 0;
+        }
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+double
+kd_div_elapsed (const struct timespec *start);
+
+double
+kd_div_elapsed (const struct timespec *start)
+{
+  struct timespec now;
+
+  (void)clock_gettime (CLOCK_MONOTONIC, &now);
+
+  return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/****************************************************************************/
+
+/*
+ * A test case: u / v with m- and n-word operands, and the expected
+ * quotient and remainder, or error if divmnu() should reject it.
+ */
+
+typedef struct
+{
+  int m;
+  int n;
+  uint32_t  u[10];
+  uint32_t  v[10];
+  uint32_t cq[10];
+  uint32_t cr[10];
+  bool error;
+  char pad[3];
+} kd_div_case_t;
+
+/****************************************************************************/
+
+/*
+ * Threads that divmnu_test() splits its loop over (0 for one per online
+ * processor), and the divisions per second that it reached.
+ */
+
+#define KD_DIV_MAX_THREADS 256
+
+int kd_div_threads  = 0;
+double kd_div_rate  = 0.0;
+
+/****************************************************************************/
+
+/*
+ * One thread's share of the divmnu_test() loop: passes first .. last
+ * over the table, with the errors found counted in errors.  Each thread
+ * checks its results, and does the once-per-case checks, on its second
+ * pass, as the single-threaded loop did.
+ */
+
+typedef struct
+{
+  pthread_t thread;
+  kd_div_case_t *test;
+  long first;
+  long last;
+  int ncases;
+  unsigned errors;
+  bool started;                              /* Running in thread.       */
+  char pad[7];
+} kd_div_worker_t;
+
+void *
+kd_div_test_worker (void *arg);
+
+void *
+kd_div_test_worker (void *arg)
+{
+  kd_div_worker_t *w   = arg;
+  kd_div_case_t *test  = w->test;
+  const int ncases     = w->ncases;
+  unsigned q[10], r[10];
+
+  for (long l = w->first; l <= w->last; l++)
+    {
+      const long pass = l - w->first;
+
+      for (int i = 0; i < ncases; i++)
+        {
+          int m        = test[i].m;
+          int n        = test[i].n;
+          uint32_t *u  = test[i].u;
+          uint32_t *v  = test[i].v;
+          uint32_t *cq = test[i].cq;
+          uint32_t *cr = test[i].cr;
+
+          int f = divmnu (q, r, u, v, m, n);
+
+          if (f && !test[i].error)
+            {
+              if (pass == 1)
+                {
+                  (void)fprintf (stderr, "\n\n");
+                  dumpit ("FATAL: Unexpected error for dividend u =", m, u);
+                  dumpit ("                            divisor  v =", n, v);
+                  w->errors++;
+                }
+            }
+
+          else if (!f && test[i].error)
+            {
+              if (pass == 1)
+                {
+                  (void)fprintf (stderr, "\n\n");
+                  dumpit ("FATAL: Unexpected success for dividend u =", m, u);
+                  dumpit ("                              divisor  v =", n, v);
+                  w->errors++;
+                }
+            }
+
+          if (!f)
+            w->errors += check (q, r, u, v, m, n, cq, cr, pass);
+
+          /* Once per case, repeat the division through a divisor context. */
+
+          if (pass == 1)
+            {
+              divmnu_ctx_t ctx;
+
+              f = divmnu_prepare (&ctx, v, n);
+
+              if (!f)
+                {
+                  f = divmnu_with_ctx (q, r, u, m, &ctx);
+                  divmnu_release (&ctx);
+                }
+
+              if ( (f != 0) != test[i].error )
+                {
+                  (void)fprintf (stderr, "\n\n");
+                  dumpit ("FATAL: Unexpected result with ctx, dividend u =",
+                          m, u);
+                  dumpit ("                                   divisor  v =",
+                          n, v);
+                  w->errors++;
+                }
+
+              else if (!f)
+                w->errors += check (q, r, u, v, m, n, cq, cr, pass);
+            }
+
+          /* And, where u < b**(2n), as a Barrett reduction modulo v. */
+
+          if (pass == 1 && !test[i].error && m <= 2 * n)
+            {
+              divmnu_barrett_t br;
+              unsigned x[20];
+
+              for (int ii = 0; ii < 2 * n; ii++)
+                x[ii] = ii < m ? u[ii] : 0;
+
+              if (divmnu_barrett_prepare (&br, v, n) != 0)
+                {
+                  (void)fprintf (stderr, "\n\n");
+                  dumpit ("FATAL: Barrett setup failed, divisor v =", n, v);
+                  w->errors++;
+                  continue;
+                }
+
+              divmnu_barrett_reduce (r, x, &br);
+              divmnu_barrett_release (&br);
+
+              for (int ii = 0; ii < n; ii++)
+                if (r[ii] != cr[ii])
+                  {
+                    (void)fprintf (stderr, "\n\n");
+                    dumpit ("FATAL: Barrett reduction of u =", m, u);
+                    dumpit ("                  modulo    v =", n, v);
+                    dumpit ("                  remainder   =", n, r);
+                    dumpit ("                  should be   =", n, cr);
+                    w->errors++;
+                    break;
+                  }
+            }
+        }
+    }
+
+#ifdef KD_DIV_STATS
+  kd_div_stats_merge ();
+#endif /* ifdef KD_DIV_STATS */
+
+  return NULL;
+}
+
+/****************************************************************************/
+
+/*
+ * An emit callback for divmnu_stream_open() that collects the quotient
+ * words into q[0..at-1], from the top down.
+ */
+
+typedef struct
+{
+  unsigned *q;                               /* Quotient.                 */
+  long      at;                              /* Words still to come.      */
+} kd_div_collect_t;
+
+void
+kd_div_collect (void *arg, const unsigned q[], int nq);
+
+void
+kd_div_collect (void *arg, const unsigned q[], int nq)
+{
+  kd_div_collect_t *c = arg;
+
+  c->at -= nq;
+
+  if (c->at >= 0)
+    (void)memcpy (&c->q[c->at], q, sizeof (unsigned) * (size_t)nq);
+}
+
+/****************************************************************************/
+
+int
+divmnu_test (void);
+
+int
+divmnu_test (void)
+{
+  static kd_div_case_t test[] = {
+
+    { .m     =   3  ,
+      .n     =   1  ,
+      .u     = { 3 },
+      .v     = { 0 },
+      .cq    = { 1 },
+      .cr    = { 1 },
+      .error = true
+    },
+
+    { .m     =      1  ,
+      .n     =      2  ,
+      .u     = { 7    },
+      .v     = { 1, 3 },
+      .cq    = {    0 },
+      .cr    = { 7, 0 },
+      .error = true
+    },
+
+    { .m     =      2  ,
+      .n     =      2  ,
+      .u     = { 0, 0 },
+      .v     = { 1, 0 },
+      .cq    = {    0 },
+      .cr    = { 0, 0 },
+      .error = true
+    },
+
+    { .m     =   1  ,
+      .n     =   1  ,
+      .u     = { 3 },
+      .v     = { 2 },
+      .cq    = { 1 },
+      .cr    = { 1 }
+    },
+
+    { .m     =   1  ,
+      .n     =   1  ,
+      .u     = { 3 },
+      .v     = { 3 },
+      .cq    = { 1 },
+      .cr    = { 0 }
+    },
+
+    { .m     =   1  ,
+      .n     =   1  ,
+      .u     = { 3 },
+      .v     = { 4 },
+      .cq    = { 0 },
+      .cr    = { 3 }
+    },
+
+    { .m     =            1  ,
+      .n     =            1  ,
+      .u     = {          0 },
+      .v     = { 0xffffffff },
+      .cq    = {          0 },
+      .cr    = {          0 }
+    },
+
+    { .m     =            1  ,
+      .n     =            1  ,
+      .u     = { 0xffffffff },
+      .v     = {          1 },
+      .cq    = { 0xffffffff },
+      .cr    = {          0 }
+    },
+
+    { .m     =            1  ,
+      .n     =            1  ,
+      .u     = { 0xffffffff },
+      .v     = { 0xffffffff },
+      .cq    = {          1 },
+      .cr    = {          0 }
+    },
+
+    { .m     =            1  ,
+      .n     =            1  ,
+      .u     = { 0xffffffff },
+      .v     = {          3 },
+      .cq    = { 0x55555555 },
       .cr    = {          0 }
     },
 
-    { .m     =            1  ,
-      .n     =            1  ,
-      .u     = { 0xffffffff },
-      .v     = {          3 },
-      .cq    = { 0x55555555 },
-      .cr    = {          0 }
-    },
+    { .m     =                        2  ,
+      .n     =                        1  ,
+      .u     = { 0xffffffff, 0xffffffff },
+      .v     = {                      1 },
+      .cq    = { 0xffffffff, 0xffffffff },
+      .cr    = {                      0 }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        1  ,
+      .u     = { 0xffffffff, 0xffffffff },
+      .v     = {             0xffffffff },
+      .cq    = {          1,          1 },
+      .cr    = {                      0 }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        1  ,
+      .u     = { 0xffffffff, 0xfffffffe },
+      .v     = {             0xffffffff },
+      .cq    = { 0xffffffff,          0 },
+      .cr    = {             0xfffffffe }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        1  ,
+      .u     = { 0x00005678, 0x00001234 },
+      .v     = {             0x00009abc },
+      .cq    = { 0x1e1dba76,          0 },
+      .cr    = {                 0x6bd0 }
+    },
+
+    { .m     =      2  ,
+      .n     =      2  ,
+      .u     = { 0, 0 },
+      .v     = { 0, 1 },
+      .cq    = {    0 },
+      .cr    = { 0, 0 }
+    },
+
+    { .m     =      2  ,
+      .n     =      2  ,
+      .u     = { 0, 7 },
+      .v     = { 0, 3 },
+      .cq    = {    2 },
+      .cr    = { 0, 1 }
+    },
+
+    { .m     =      2  ,
+      .n     =      2  ,
+      .u     = { 5, 7 },
+      .v     = { 0, 3 },
+      .cq    = {    2 },
+      .cr    = { 5, 1 }
+    },
+
+    { .m     =      2  ,
+      .n     =      2  ,
+      .u     = { 0, 6 },
+      .v     = { 0, 2 },
+      .cq    = {    3 },
+      .cr    = { 0, 0 }
+    },
+
+    { .m     =            1  ,
+      .n     =            1  ,
+      .u     = { 0x80000000 },
+      .v     = { 0x40000001 },
+      .cq    = { 0x00000001 },
+      .cr    = { 0x3fffffff }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        1  ,
+      .u     = { 0x00000000, 0x80000000 },
+      .v     = {             0x40000001 },
+      .cq    = { 0xfffffff8, 0x00000001 },
+      .cr    = {             0x00000008 }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        2  ,
+      .u     = { 0x00000000, 0x80000000 },
+      .v     = { 0x00000001, 0x40000000 },
+      .cq    = {             0x00000001 },
+      .cr    = { 0xffffffff, 0x3fffffff }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        2  ,
+      .u     = { 0x0000789a, 0x0000bcde },
+      .v     = { 0x0000789a, 0x0000bcde },
+      .cq    = {                      1 },
+      .cr    = {          0,          0 }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        2  ,
+      .u     = { 0x0000789b, 0x0000bcde },
+      .v     = { 0x0000789a, 0x0000bcde },
+      .cq    = {                      1 },
+      .cr    = {          1,          0 }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        2  ,
+      .u     = { 0x00007899, 0x0000bcde },
+      .v     = { 0x0000789a, 0x0000bcde },
+      .cq    = {                      0 },
+      .cr    = { 0x00007899, 0x0000bcde }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        2  ,
+      .u     = { 0x0000ffff, 0x0000ffff },
+      .v     = { 0x0000ffff, 0x0000ffff },
+      .cq    = {                      1 },
+      .cr    = {          0,          0 }
+    },
+
+    { .m     =                        2  ,
+      .n     =                        2  ,
+      .u     = { 0x0000ffff, 0x0000ffff },
+      .v     = { 0x00000000, 0x00000001 },
+      .cq    = {             0x0000ffff },
+      .cr    = { 0x0000ffff,          0 }
+    },
+
+    { .m     =                                    3  ,
+      .n     =                                    2  ,
+      .u     = { 0x000089ab, 0x00004567, 0x00000123 },
+      .v     = { 0x00000000, 0x00000001             },
+      .cq    = { 0x00004567, 0x00000123             },
+      .cr    = {             0x000089ab,          0 }
+    },
+
+    { .m     =                                    3  ,
+      .n     =                                    2  ,
+      .u     = { 0x00000000, 0x0000fffe, 0x00008000 },
+      .v     = {             0x0000ffff, 0x00008000 },
+      .cq    = {             0xffffffff, 0x00000000 },
+      .cr    = {             0x0000ffff, 0x00007fff }
+    },
+
+    { .m     =                                    3  ,
+      .n     =                                    3  ,
+      .u     = { 0x00000003, 0x00000000, 0x80000000 },
+      .v     = { 0x00000001, 0x00000000, 0x20000000 },
+      .cq    = {                         0x00000003 },
+      .cr    = {          0,          0, 0x20000000 }
+    },
+
+    { .m     =                                    3  ,
+      .n     =                                    3  ,
+      .u     = { 0x00000003, 0x00000000, 0x00008000 },
+      .v     = { 0x00000001, 0x00000000, 0x00002000 },
+      .cq    = {                         0x00000003 },
+      .cr    = {          0,          0, 0x00002000 }
+    },
+
+    { .m     =                                                4  ,
+      .n     =                                                3  ,
+      .u     = {          0,          0, 0x00008000, 0x00007fff },
+      .v     = {                      1,          0, 0x00008000 },
+      .cq    = {                         0xfffe0000,          0 },
+      .cr    = {             0x00020000, 0xffffffff, 0x00007fff}
+    },
+
+    { .m     =                                                4  ,
+      .n     =                                                3  ,
+      .u     = {          0, 0x0000fffe,          0, 0x00008000 },
+      .v     = {             0x0000ffff,          0, 0x00008000 },
+      .cq    = {                         0xffffffff,          0 },
+      .cr    = {             0x0000ffff, 0xffffffff, 0x00007fff }
+    },
+
+    { .m     =                                                4  ,
+      .n     =                                                3  ,
+      .u     = {          0, 0xfffffffe,          0, 0x80000000 },
+      .v     = {             0x0000ffff,          0, 0x80000000 },
+      .cq    = {                         0x00000000,          1 },
+      .cr    = {             0x00000000, 0xfffeffff, 0x00000000 }
+    },
+
+    { .m     =                                                4  ,
+      .n     =                                                3  ,
+      .u     = {          0, 0xfffffffe,          0, 0x80000000 },
+      .v     = {             0xffffffff,          0, 0x80000000 },
+      .cq    = {                         0xffffffff,          0 },
+      .cr    = {             0xffffffff, 0xffffffff, 0x7fffffff }
+    },
+  };
+
+  unsigned q[10], r[10];
+  unsigned errors  = 0;
+  const int ncases = sizeof (test) / sizeof (test[0]);
+  const long loops = 12000000L;
+
+  int nthreads = kd_div_threads > 0 ? kd_div_threads :
+                   (int)sysconf (_SC_NPROCESSORS_ONLN);
+  kd_div_worker_t w[KD_DIV_MAX_THREADS];
+  struct timespec start;
+
+  if (nthreads < 1)
+    nthreads = 1;
+  else if (nthreads > KD_DIV_MAX_THREADS)
+    nthreads = KD_DIV_MAX_THREADS;
+
+  /*
+   * Split the passes over the table evenly between the threads.  The
+   * calling thread takes the first share, and also any share whose
+   * thread could not be started.
+   */
+
+  (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+  for (int t = 0; t < nthreads; t++)
+    {
+      w[t].test    = test;
+      w[t].ncases  = ncases;
+      w[t].first   = (loops + 1) * t / nthreads;
+      w[t].last    = (loops + 1) * (t + 1) / nthreads - 1;
+      w[t].errors  = 0;
+      w[t].started = t > 0 &&
+        pthread_create (&w[t].thread, NULL, kd_div_test_worker, &w[t]) == 0;
+    }
+
+  for (int t = 0; t < nthreads; t++)
+    {
+      if (w[t].started)
+        (void)pthread_join (w[t].thread, NULL);
+      else
+        (void)kd_div_test_worker (&w[t]);
+
+      errors += w[t].errors;
+    }
+
+  kd_div_rate = (double)(loops + 1) * ncases / kd_div_elapsed (&start);
+
+  /*
+   * Divide the cases of each size together with divmnu_batch(), nine
+   * problems to a batch so that both its vector and its scalar paths
+   * are used, and check every problem of the batch.
+   */
+
+  enum { NB = 9 };
+
+  for (int i = 0; i < ncases; i++)
+    {
+      unsigned bu[10 * NB], bv[10 * NB], bq[10 * NB], br[10 * NB];
+      int idx[NB], len = 0;
+      int m = test[i].m;
+      int n = test[i].n;
+
+      for (int k = 0; k < ncases && len < NB; k++)
+        if (!test[i].error && !test[k].error &&
+            test[k].m == m && test[k].n == n)
+          idx[len++] = k;
+
+      if (test[i].error)
+        idx[len++] = i;
+      else if (idx[0] != i)
+        continue;                            /* Size already done.       */
+
+      for (int k = 0; k < NB; k++)
+        {
+          for (int ii = 0; ii < m; ii++)
+            bu[ii * NB + k] = test[idx[k % len]].u[ii];
+
+          for (int ii = 0; ii < n; ii++)
+            bv[ii * NB + k] = test[idx[k % len]].v[ii];
+        }
+
+      int f = divmnu_batch (bq, br, bu, bv, m, n, NB);
+
+      if ( (f != 0) != test[i].error )
+        {
+          (void)fprintf (stderr, "\n\n");
+          dumpit ("FATAL: Unexpected batch result, dividend u =",
+                  m, test[i].u);
+          dumpit ("                               divisor  v =",
+                  n, test[i].v);
+          errors++;
+        }
+
+      else if (!f)
+        for (int k = 0; k < NB; k++)
+          {
+            int c = idx[k % len];
+
+            for (int ii = 0; ii <= m - n; ii++)
+              q[ii] = bq[ii * NB + k];
+
+            for (int ii = 0; ii < n; ii++)
+              r[ii] = br[ii * NB + k];
+
+            errors += check (q, r, test[c].u, test[c].v, m, n,
+                             test[c].cq, test[c].cr, 1);
+          }
+    }
+
+  /*
+   * Modular exponentiation: known results, then random operands checked
+   * against the square-and-multiply reference.
+   */
+
+  {
+    static const unsigned p127[4] = {
+      0xffffffff, 0xffffffff, 0xffffffff, 0x7fffffff
+    };
+    static const unsigned p127m1[4] = {
+      0xfffffffe, 0xffffffff, 0xffffffff, 0x7fffffff
+    };
+    unsigned g[20], e[4], mod[8], ra[8], rb[8];
+
+    g[0] = 4; e[0] = 13; mod[0] = 497;
+
+    if (divmnu_modexp (ra, g, 1, e, 1, mod, 1) != 0 || ra[0] != 445)
+      {
+        (void)fprintf (stderr, "\n\nFATAL: 4**13 mod 497 != 445\n");
+        errors++;
+      }
+
+    g[0] = 2;
+
+    if (divmnu_modexp (ra, g, 1, p127m1, 4, p127, 4) != 0 ||
+        ra[0] != 1 || ra[1] != 0 || ra[2] != 0 || ra[3] != 0)
+      {
+        (void)fprintf (stderr, "\n\nFATAL: 2**(p-1) mod p != 1, "
+                       "p = 2**127 - 1\n");
+        errors++;
+      }
+
+    mod[0] = 498;
+
+    if (divmnu_modexp (ra, g, 1, e, 1, mod, 1) != 1)
+      {
+        (void)fprintf (stderr, "\n\nFATAL: Even modulus accepted\n");
+        errors++;
+      }
+
+    for (int i = 0; i < 200; i++)
+      {
+        int n  = 1 + (int)(kd_div_random () % 8);
+        int ng = 1 + (int)(kd_div_random () % (unsigned)(2 * n + 2));
+        int ne = (int)(kd_div_random () % 4);
+
+        for (int ii = 0; ii < ng; ii++)
+          g[ii] = kd_div_random ();
+
+        for (int ii = 0; ii < ne; ii++)
+          e[ii] = kd_div_random () >> (kd_div_random () % 32);
+
+        for (int ii = 0; ii < n; ii++)
+          mod[ii] = kd_div_random ();
+
+        mod[0]     = mod[0] | 1;
+        mod[n - 1] = mod[n - 1] | ( i % 2 ? 1 : 0x80000000 );
+
+        if (divmnu_modexp (ra, g, ng, e, ne, mod, n) != 0 ||
+            divmnu_modexp_ref (rb, g, ng, e, ne, mod, n) != 0 ||
+            memcmp (ra, rb, sizeof (unsigned) * (size_t)n) != 0)
+          {
+            (void)fprintf (stderr, "\n\n");
+            dumpit ("FATAL: Modular exponentiation, g =", ng, g);
+            dumpit ("                               e =", ne, e);
+            dumpit ("                             mod =", n, mod);
+            dumpit ("                          result =", n, ra);
+            dumpit ("                       should be =", n, rb);
+            errors++;
+          }
+      }
+  }
+
+  /*
+   * Burnikel-Ziegler and Newton division, with thresholds low enough
+   * that the table cases and random operands of up to 40 words take
+   * every path of the recursions and of the multiplications under them,
+   * checked against the table and against Algorithm D alone.
+   */
+
+  {
+    const int bz_was   = kd_div_bz_threshold;
+    const int kara_was = kd_div_karatsuba_threshold;
+    const int ntt_was  = kd_div_ntt_threshold;
+    const int nwt_was  = kd_div_newton_threshold;
+    unsigned u[100], v[40], q2[101], r2[40];
+    unsigned qb[101], rb[40];
+
+    kd_div_bz_threshold        = 2;
+    kd_div_karatsuba_threshold = 4;
+    kd_div_ntt_threshold       = 12;
+    kd_div_newton_threshold    = 8;
+
+    for (int i = 0; i < 2 * ncases; i++)
+      {
+        int c = i % ncases;
+        int m = test[c].m;
+        int n = test[c].n;
+        int f = i < ncases ? divmnu_bz (q, r, test[c].u, test[c].v, m, n)
+                           : divmnu_newton (q, r, test[c].u, test[c].v, m, n);
+
+        if ( (f != 0) != test[c].error )
+          {
+            (void)fprintf (stderr, "\n\n");
+            dumpit ("FATAL: Unexpected result with bz/newton, dividend u =",
+                    m, test[c].u);
+            dumpit ("                                         divisor  v =",
+                    n, test[c].v);
+            errors++;
+          }
+
+        else if (!f)
+          errors += check (q, r, test[c].u, test[c].v, m, n,
+                           test[c].cq, test[c].cr, 1);
+      }
+
+    for (int i = 0; i < 400; i++)
+      {
+        int n = 1 + (int)(kd_div_random () % 40);
+        int m = n + (int)(kd_div_random () % (unsigned)(100 - n));
+
+        for (int ii = 0; ii < m; ii++)
+          u[ii] = i % 4 == 1 ? UINT32_MAX :
+                    kd_div_random () >> (kd_div_random () % 4 == 0 ? 0 : 31);
+
+        for (int ii = 0; ii < n; ii++)
+          v[ii] = i % 3 == 0 ? UINT32_MAX : kd_div_random ();
+
+        v[n - 1] = v[n - 1] >> (kd_div_random () % 32) | 1;
+
+        int f = i % 3 == 0 ? divmnu_bz (qb, rb, u, v, m, n) :
+                i % 3 == 1 ? divmnu_newton (qb, rb, u, v, m, n) :
+                             divmnu_auto (qb, rb, u, v, m, n);
+
+        if (f != 0 || kd_div_knuth (q2, r2, u, v, m, n) != 0 ||
+            memcmp (qb, q2, sizeof (unsigned) * (size_t)(m - n + 1)) != 0 ||
+            memcmp (rb, r2, sizeof (unsigned) * (size_t)n) != 0)
+          {
+            (void)fprintf (stderr, "\n\n");
+            dumpit ("FATAL: bz/newton/auto differs from divmnu, u =", m, u);
+            dumpit ("                                           v =", n, v);
+            errors++;
+          }
+      }
+
+    kd_div_bz_threshold        = bz_was;
+    kd_div_karatsuba_threshold = kara_was;
+    kd_div_ntt_threshold       = ntt_was;
+    kd_div_newton_threshold    = nwt_was;
+  }
+
+  /*
+   * Large operands of every distribution of kd_div_generate(), with
+   * divisors spanning several strips of the two-stage kernels, checked
+   * by multiplying back; and a wrong quotient must not pass that check.
+   * The divisions go in turn through divmnu(), divmnu_with_scratch(),
+   * reusing the multiply-back workspace, which is at least as big as
+   * needed, and divmnu_in_place() on a copy of u that is left holding
+   * the remainder.  Every fourth divisor has its top bit set, so that
+   * normalization is skipped.
+   */
+
+  {
+    enum { MAXM = 4096, MAXN = 2560 };
+
+    unsigned *u  = malloc (sizeof (unsigned) * (5 * MAXM + 3 * MAXN + 5));
+    unsigned *v  = &u[MAXM];
+    unsigned *ql = &v[MAXN];
+    unsigned *rl = &ql[MAXM + 1];
+    unsigned *ws = &rl[MAXN];
+    unsigned *uc = &ws[2 * MAXM + MAXN + 3];
+
+    if (u == NULL)
+      return 1;
+
+    for (int i = 0; i < 24; i++)
+      {
+        kd_div_dist_t dist = (kd_div_dist_t)(i % kd_div_ndists);
+        int n = 1 + (int)(kd_div_random () % MAXN);
+        int m = n + (int)(kd_div_random () % (unsigned)(MAXM - n + 1));
+
+        kd_div_generate (u, m, v, n, dist);
+
+        if (i % 4 == 3)
+          v[n - 1] |= 0x80000000;
+
+        int f;
+
+        if (i % 3 == 0)
+          f = divmnu (ql, rl, u, v, m, n);
+        else if (i % 3 == 1)
+          f = divmnu_with_scratch (ql, rl, u, v, m, n, ws);
+        else
+          {
+            (void)memcpy (uc, u, sizeof (unsigned) * (size_t)m);
+            f = divmnu_in_place (ql, uc, uc, v, m, n, ws);
+            (void)memcpy (rl, uc, sizeof (unsigned) * (size_t)n);
+          }
+
+        if (f != 0 || !kd_div_verify (ql, rl, u, v, m, n, ws))
+          {
+            (void)fprintf (stderr, "\n\nFATAL: q * v + r != u for %s "
+                           "operands, m = %d, n = %d\n",
+                           kd_div_dist_names[dist], m, n);
+            errors++;
+          }
+
+        ql[0] ^= 1;
+
+        if (kd_div_verify (ql, rl, u, v, m, n, ws))
+          {
+            (void)fprintf (stderr, "\n\nFATAL: kd_div_verify() passed a "
+                           "wrong quotient, m = %d, n = %d\n", m, n);
+            errors++;
+          }
+      }
+
+    free (u);
+  }
+
+  /*
+   * The one- and two-word divisor paths, through divmnu() and a divisor
+   * context, on operands of every distribution up to 100 words, checked
+   * by multiplying back.
+   */
+
+  for (int i = 0; i < 400; i++)
+    {
+      kd_div_dist_t dist = (kd_div_dist_t)(i % kd_div_ndists);
+      int n = 1 + (i / kd_div_ndists) % 2;
+      int m = n + (int)(kd_div_random () % (unsigned)(101 - n));
+      unsigned u[100], v[2], q2[100], r2[2], ws[2 * 100 + 2 + 3];
+      divmnu_ctx_t ctx;
+
+      kd_div_generate (u, m, v, n, dist);
+
+      int f = divmnu (q2, r2, u, v, m, n) != 0 ||
+              !kd_div_verify (q2, r2, u, v, m, n, ws);
+
+      if (divmnu_prepare (&ctx, v, n) == 0)
+        {
+          f = f || divmnu_with_ctx (q2, r2, u, m, &ctx) != 0 ||
+              !kd_div_verify (q2, r2, u, v, m, n, ws);
+          f = f || divmnu_with_ctx_scratch (q2, r2, u, m, &ctx, ws) != 0 ||
+              !kd_div_verify (q2, r2, u, v, m, n, ws);
+          divmnu_release (&ctx);
+        }
+
+      if (f)
+        {
+          (void)fprintf (stderr, "\n\n");
+          dumpit ("FATAL: short divisor path wrong, u =", m, u);
+          dumpit ("                                 v =", n, v);
+          errors++;
+        }
+    }
+
+  /*
+   * Exact division of products q * v, with divisors of every
+   * distribution that are odd, or end in a zero word or zero bits; with
+   * -DKD_DIV_EXACT_CHECK, an inexact division must be caught.
+   */
+
+  {
+    enum { MAXQ = 300, MAXV = 300 };
+
+    /* ws is scratch for both kd_div_mul() and divmnu_exact(). */
+
+    int nws = kd_div_mul_scratch (MAXQ, MAXV);
+
+    if (nws < divmnu_scratch_words (MAXQ + MAXV, MAXV))
+      nws = (int)divmnu_scratch_words (MAXQ + MAXV, MAXV);
+
+    unsigned *q   = malloc (sizeof (unsigned) *
+                            (size_t)(3 * MAXQ + 2 * MAXV + 1 + nws));
+    unsigned *v   = &q[MAXQ];
+    unsigned *u   = &v[MAXV];
+    unsigned *qe  = &u[MAXQ + MAXV];
+    unsigned *ws  = &qe[MAXQ + 1];
+
+    if (q == NULL)
+      return 1;
+
+    for (int i = 0; i < 200; i++)
+      {
+        kd_div_dist_t dist = (kd_div_dist_t)(i % kd_div_ndists);
+        int qn = 1 + (int)(kd_div_random () % MAXQ);
+        int n  = 1 + (int)(kd_div_random () % MAXV);
+        int m  = qn + n;
+
+        kd_div_generate (q, qn, v, n, dist);
+
+        if (i % 3 == 0)
+          v[0] |= 1;
+        else if (i % 3 == 1 && n > 1)
+          v[0] = 0;
+        else
+          v[0] &= ~0xffu;
+
+        if (v[0] == 0 && n == 1)
+          v[0] = 0x100;
+
+        kd_div_mul (u, q, qn, v, n, ws);
+
+        int f = divmnu_exact (qe, u, v, m, n, ws) != 0 || qe[qn] != 0;
+
+        for (int j = 0; j < qn; j++)
+          f = f || qe[j] != q[j];
+
+        if (f)
+          {
+            (void)fprintf (stderr, "\n\nFATAL: divmnu_exact() wrong for %s "
+                           "operands, m = %d, n = %d\n",
+                           kd_div_dist_names[dist], m, n);
+            errors++;
+          }
+
+#ifdef KD_DIV_EXACT_CHECK
+        u[0] ^= 1;
+
+        if ( (n > 1 || v[0] != 1) && divmnu_exact (qe, u, v, m, n, ws) != 3)
+          {
+            (void)fprintf (stderr, "\n\nFATAL: divmnu_exact() passed an "
+                           "inexact division, m = %d, n = %d\n", m, n);
+            errors++;
+          }
+#endif /* ifdef KD_DIV_EXACT_CHECK */
+      }
+
+    free (q);
+  }
+
+  /*
+   * Streaming division, fed in pieces of random sizes, against divmnu();
+   * and every tenth case through divmnu_file() and temporary files.
+   */
+
+  {
+    enum { MAXM = 3000, MAXN = 300 };
+
+    unsigned *u  = malloc (sizeof (unsigned) * (3 * MAXM + 3 * MAXN + 2));
+    unsigned *v  = &u[MAXM];
+    unsigned *q  = &v[MAXN];
+    unsigned *r  = &q[MAXM + 1];
+    unsigned *qs = &r[MAXN];
+    unsigned *rs = &qs[MAXM + 1];
+
+    if (u == NULL)
+      return 1;
+
+    for (int i = 0; i < 60; i++)
+      {
+        kd_div_dist_t dist = (kd_div_dist_t)(i % kd_div_ndists);
+        int n  = 1 + (int)(kd_div_random () % MAXN);
+        int m  = n + (int)(kd_div_random () % (unsigned)(MAXM - n + 1));
+        int qn = m - n + 1;
+        int f;
+        divmnu_stream_t  st;
+        kd_div_collect_t c = { qs, qn };
+
+        kd_div_generate (u, m, v, n, dist);
+
+        f = divmnu (q, r, u, v, m, n) != 0 ||
+            divmnu_stream_open (&st, v, n, kd_div_collect, &c) != 0;
+
+        for (long hi = m, k; !f && hi > 0; hi -= k)
+          {
+            k = 1 + (long)(kd_div_random () % 700);
+            k = k < hi ? k : hi;
+            divmnu_stream_feed (&st, &u[hi - k], k);
+          }
+
+        f = f || divmnu_stream_close (&st, rs) != 0 || c.at != 0 ||
+            memcmp (q, qs, sizeof (unsigned) * (size_t)qn) != 0 ||
+            memcmp (r, rs, sizeof (unsigned) * (size_t)n) != 0;
+
+        if (!f && i % 10 == 0)
+          {
+            char upath[] = "/tmp/divmnu-u-XXXXXX";
+            char qpath[] = "/tmp/divmnu-q-XXXXXX";
+            int  ufd     = mkstemp (upath);
+            int  qfd     = mkstemp (qpath);
+            FILE *fp     = NULL;
+
+            f = ufd < 0 || qfd < 0 ||
+                write (ufd, u, sizeof (unsigned) * (size_t)m) !=
+                  (ssize_t)(sizeof (unsigned) * (size_t)m) ||
+                divmnu_file (upath, qpath, rs, v, n) != 0 ||
+                (fp = fopen (qpath, "rb")) == NULL ||
+                fread (qs, sizeof (unsigned), (size_t)qn + 1, fp) !=
+                  (size_t)qn ||
+                memcmp (q, qs, sizeof (unsigned) * (size_t)qn) != 0 ||
+                memcmp (r, rs, sizeof (unsigned) * (size_t)n) != 0;
+
+            if (fp != NULL)
+              (void)fclose (fp);
+
+            /* The same file for both must be refused, and left alone. */
+
+            fp = NULL;
+            f  = f || divmnu_file (upath, upath, rs, v, n) != 1 ||
+                 (fp = fopen (upath, "rb")) == NULL ||
+                 fread (qs, sizeof (unsigned), (size_t)m + 1, fp) !=
+                   (size_t)m ||
+                 memcmp (u, qs, sizeof (unsigned) * (size_t)m) != 0;
+
+            if (fp != NULL)
+              (void)fclose (fp);
+
+            if (ufd >= 0)
+              {
+                (void)close (ufd);
+                (void)unlink (upath);
+              }
+
+            if (qfd >= 0)
+              {
+                (void)close (qfd);
+                (void)unlink (qpath);
+              }
+          }
+
+        if (f)
+          {
+            (void)fprintf (stderr, "\n\nFATAL: streaming division wrong "
+                           "for %s operands, m = %d, n = %d\n",
+                           kd_div_dist_names[dist], m, n);
+            errors++;
+          }
+      }
+
+    free (u);
+  }
+
+  if (errors > 0)
+    return 1;
+  else
+    return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Benchmark timing.  kd_div_bench_time() calls op on the count
+ * dividends of o in turn, first for 2 ms to warm up and to size the
+ * samples from the rate seen there, then for KD_DIV_BENCH_SAMPLES
+ * samples of as many calls, and returns the best sample in ns per call.
+ * The benchmarks below time their operations with it, on operands from
+ * kd_div_bench_alloc().
+ */
+
+#define KD_DIV_BENCH_SAMPLES 5
+
+typedef int (*kd_div_divide_t) (unsigned q[], unsigned r[],
+                                const unsigned u[], const unsigned v[],
+                                int m, int n);
+
+typedef struct
+{
+  unsigned        *u;                        /* count dividends, m words. */
+  unsigned        *v;                        /* Divisor, n words.         */
+  unsigned        *q;                        /* Quotient.                 */
+  unsigned        *r;                        /* Remainder.                */
+  unsigned        *ws;                       /* Scratch space, or NULL.   */
+  const void      *arg;                      /* Context, Barrett state... */
+  kd_div_divide_t  divide;                   /* For kd_div_op_divide().   */
+  int              m;
+  int              n;
+  int              count;
+  int              lanes;                    /* For kd_div_op_batch().    */
+} kd_div_operands_t;
+
+typedef void (*kd_div_op_t) (const kd_div_operands_t *o, const unsigned u[]);
+
+/****************************************************************************/
+
+/*
+ * Time op as above.  If calls is not NULL, the number of calls made,
+ * warm-up included, is stored there.
+ */
+
+double
+kd_div_bench_time (kd_div_op_t op, const kd_div_operands_t *o, long *calls);
+
+double
+kd_div_bench_time (kd_div_op_t op, const kd_div_operands_t *o, long *calls)
+{
+  struct timespec start;
+  double best = 0.0;
+  long reps   = 0;
+
+  /* Warm up for 2 ms, and size the samples from the rate seen there. */
+
+  (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+  do
+    op (o, &o->u[(reps++ % o->count) * o->m]);
+  while (kd_div_elapsed (&start) < 2e-3);
+
+  for (int t = 0; t < KD_DIV_BENCH_SAMPLES; t++)
+    {
+      (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+      for (long l = 0; l < reps; l++)
+        op (o, &o->u[(l % o->count) * o->m]);
+
+      double ns = kd_div_elapsed (&start) * 1e9 / (double)reps;
+
+      if (t == 0 || ns < best)
+        best = ns;
+    }
+
+  if (calls != NULL)
+    *calls = reps * (KD_DIV_BENCH_SAMPLES + 1);
+
+  return best;
+}
+
+/****************************************************************************/
+
+void
+kd_div_bench_free (kd_div_operands_t *o);
+
+void
+kd_div_bench_free (kd_div_operands_t *o)
+{
+  free (o->u);
+  free (o->v);
+  free (o->q);
+  free (o->r);
+  free (o->ws);
+
+  o->u  = NULL;
+  o->v  = NULL;
+  o->q  = NULL;
+  o->r  = NULL;
+  o->ws = NULL;
+}
+
+/****************************************************************************/
+
+/*
+ * Allocate o for count dividends of m words and a divisor of n words,
+ * with nws words of scratch space, and fill the dividends and the
+ * divisor with random words, v[n-1] odd; o->divide is divmnu().  If out
+ * of memory, report it for bench, free what was allocated and return
+ * false.
+ */
+
+bool
+kd_div_bench_alloc (kd_div_operands_t *o, const char *bench, int m, int n,
+                    int count, int nws);
+
+bool
+kd_div_bench_alloc (kd_div_operands_t *o, const char *bench, int m, int n,
+                    int count, int nws)
+{
+  *o = (kd_div_operands_t)
+    {
+      .u      = malloc (sizeof (unsigned) * (size_t)m * (size_t)count),
+      .v      = malloc (sizeof (unsigned) * (size_t)n),
+      .q      = malloc (sizeof (unsigned) * (size_t)(m - n + 1)),
+      .r      = malloc (sizeof (unsigned) * (size_t)n),
+      .ws     = nws > 0 ? malloc (sizeof (unsigned) * (size_t)nws) : NULL,
+      .divide = divmnu,
+      .m      = m,
+      .n      = n,
+      .count  = count,
+      .lanes  = 1
+    };
+
+  if (o->u == NULL || o->v == NULL || o->q == NULL || o->r == NULL ||
+      (nws > 0 && o->ws == NULL))
+    {
+      (void)fprintf (stderr, "%s: out of memory\n", bench);
+      kd_div_bench_free (o);
+
+      return false;
+    }
+
+  for (long k = 0; k < (long)m * count; k++)
+    o->u[k] = kd_div_random ();
+
+  for (int k = 0; k < n; k++)
+    o->v[k] = kd_div_random ();
+
+  o->v[n - 1] = o->v[n - 1] | 1;
+
+  return true;
+}
+
+/****************************************************************************/
+
+/*
+ * The operations the benchmarks time, on the dividend u of o, with the
+ * rest of the operands and any state (o->arg, o->ws) in o.
+ */
+
+void
+kd_div_op_divide (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_divide (const kd_div_operands_t *o, const unsigned u[])
+{
+  (void)o->divide (o->q, o->r, u, o->v, o->m, o->n);
+}
+
+void
+kd_div_op_ctx (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_ctx (const kd_div_operands_t *o, const unsigned u[])
+{
+  (void)divmnu_with_ctx (o->q, o->r, u, o->m, o->arg);
+}
+
+void
+kd_div_op_barrett (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_barrett (const kd_div_operands_t *o, const unsigned u[])
+{
+  divmnu_barrett_reduce (o->r, u, o->arg);
+}
+
+void
+kd_div_op_scratch (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_scratch (const kd_div_operands_t *o, const unsigned u[])
+{
+  (void)divmnu_with_scratch (o->q, o->r, u, o->v, o->m, o->n, o->ws);
+}
+
+void
+kd_div_op_exact (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_exact (const kd_div_operands_t *o, const unsigned u[])
+{
+  (void)divmnu_exact (o->q, u, o->v, o->m, o->n, o->ws);
+}
+
+void
+kd_div_op_modexp (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_modexp (const kd_div_operands_t *o, const unsigned u[])
+{
+  (void)divmnu_modexp (o->r, u, o->n, o->v, o->n, o->arg, o->n);
+}
+
+void
+kd_div_op_modexp_ref (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_modexp_ref (const kd_div_operands_t *o, const unsigned u[])
+{
+  (void)divmnu_modexp_ref (o->r, u, o->n, o->v, o->n, o->arg, o->n);
+}
+
+void
+kd_div_op_1 (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_1 (const kd_div_operands_t *o, const unsigned u[])
+{
+  divmnu_1 (o->q, o->r, u, o->m, o->v[0]);
+}
+
+void
+kd_div_op_1_preinv (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_1_preinv (const kd_div_operands_t *o, const unsigned u[])
+{
+  const int s1 = nlz (o->v[0]);
+  uint32_t d   = o->v[0] << s1;
+
+  divmnu_1_preinv (o->q, o->r, u, o->m, d, s1, reciprocal_word (d));
+}
+
+/* The old n = 2 path: a normalized copy in o->ws, and the kernel. */
+
+void
+kd_div_op_2_core (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_2_core (const kd_div_operands_t *o, const unsigned u[])
+{
+  divmnu_ctx_t ctx;
+
+  kd_div_setup (&ctx, &o->ws[o->m + 1], o->v, o->n,
+                kd_div_qhat != KD_DIV_QHAT_HWDIV);
+  divmnu_core (o->q, o->r, u, o->m, &ctx, kd_div_qhat, kd_div_mulsub,
+               o->ws);
+}
+
+void
+kd_div_op_batch (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_batch (const kd_div_operands_t *o, const unsigned u[])
+{
+  (void)divmnu_batch (o->q, o->r, u, o->v, o->m, o->n, o->lanes);
+}
+
+/* The o->lanes interleaved problems at u one at a time (m <= 64). */
+
+void
+kd_div_op_batch_each (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_batch_each (const kd_div_operands_t *o, const unsigned u[])
+{
+  const int lanes = o->lanes;
+  unsigned uk[64], vk[64], qk[64], rk[64];
+
+  for (int k = 0; k < lanes; k++)
+    {
+      for (int i = 0; i < o->m; i++)
+        uk[i] = u[i * lanes + k];
+
+      for (int i = 0; i < o->n; i++)
+        vk[i] = o->v[i * lanes + k];
+
+      (void)divmnu (qk, rk, uk, vk, o->m, o->n);
+
+      for (int i = 0; i <= o->m - o->n; i++)
+        o->q[i * lanes + k] = qk[i];
+
+      for (int i = 0; i < o->n; i++)
+        o->r[i * lanes + k] = rk[i];
+    }
+}
+
+/* Not a division: u times the divisor, into o->q (o->m + o->n words). */
+
+void
+kd_div_op_mul (const kd_div_operands_t *o, const unsigned u[]);
+
+void
+kd_div_op_mul (const kd_div_operands_t *o, const unsigned u[])
+{
+  kd_div_mul (o->q, u, o->m, o->v, o->n, o->ws);
+}
+
+/****************************************************************************/
+
+/*
+ * Repeated-divisor benchmark: divide a set of dividends by one divisor,
+ * once with divmnu() and once with a context from divmnu_prepare(),
+ * for both quotient digit estimations, and report ns per division.
+ */
+
+int
+divmnu_bench_ctx (void);
+
+int
+divmnu_bench_ctx (void)
+{
+  static const struct
+  {
+    int m;
+    int n;
+  } size[] = {
+    {   3,  2 }, {   8,  2 }, {   8,  4 }, {  16,  4 },
+    {  16,  8 }, {  64,  8 }, {  64, 32 }, { 256, 32 },
+  };
+
+  enum { NDIVIDENDS = 64 };
+
+  const int nsizes       = sizeof (size) / sizeof (size[0]);
+  kd_div_qhat_t qhat_was = kd_div_qhat;
+  int failed             = 0;
+
+  (void)printf ("%5s %5s %12s %12s %12s %12s %8s\n", "m", "n",
+                "divmnu", "divmnu/rcp", "ctx", "ctx/rcp", "gain");
+
+  for (int i = 0; i < nsizes && !failed; i++)
+    {
+      const int m = size[i].m;
+      const int n = size[i].n;
+      kd_div_operands_t o;
+      double ns[4];
+
+      if (!kd_div_bench_alloc (&o, "divmnu_bench_ctx", m, n, NDIVIDENDS,
+                               0))
+        {
+          failed = 1;
+          break;
+        }
+
+      for (int t = 0; t < 4 && !failed; t++)
+        {
+          divmnu_ctx_t ctx;
+
+          kd_div_qhat = t & 1 ? KD_DIV_QHAT_RECIPROCAL : KD_DIV_QHAT_HWDIV;
+          failed      = divmnu_prepare (&ctx, o.v, n) != 0;
+
+          if (failed)
+            break;
+
+          o.arg = &ctx;
+          ns[t] = kd_div_bench_time (t < 2 ? kd_div_op_divide
+                                           : kd_div_op_ctx, &o, NULL);
+
+          divmnu_release (&ctx);
+        }
+
+      if (!failed)
+        {
+          double best = ns[2] < ns[3] ? ns[2] : ns[3];
+
+          (void)printf ("%5d %5d %12.1f %12.1f %12.1f %12.1f %7.2fx\n", m,
+                        n, ns[0], ns[1], ns[2], ns[3], ns[0] / best);
+        }
+
+      kd_div_bench_free (&o);
+    }
+
+  kd_div_qhat = qhat_was;
+
+  return failed;
+}
+
+/****************************************************************************/
+
+/*
+ * Batch benchmark: the same lane-interleaved batch of divisions done
+ * with divmnu() one problem at a time and with divmnu_batch(), in ns
+ * per division.
+ */
+
+int
+divmnu_bench_batch (void);
+
+int
+divmnu_bench_batch (void)
+{
+  static const struct
+  {
+    int m;
+    int n;
+  } size[] = {
+    {   4,  2 }, {   8,  2 }, {   8,  4 }, {  16,  4 },
+    {  16,  8 }, {  32,  8 }, {  64, 16 },
+  };
+
+  enum { COUNT = 1024 };
+
+  const int nsizes = sizeof (size) / sizeof (size[0]);
+
+  (void)printf ("%5s %5s %12s %12s %8s\n", "m", "n",
+                "divmnu", "batch", "gain");
+
+  for (int i = 0; i < nsizes; i++)
+    {
+      const int m = size[i].m;
+      const int n = size[i].n;
+      double ns[2];
+
+      /* One batch of COUNT problems, as one interleaved dividend. */
+
+      kd_div_operands_t o = {
+        .u     = malloc (sizeof (unsigned) * (size_t)(m * COUNT)),
+        .v     = malloc (sizeof (unsigned) * (size_t)(n * COUNT)),
+        .q     = malloc (sizeof (unsigned) * (size_t)(m * COUNT)),
+        .r     = malloc (sizeof (unsigned) * (size_t)(n * COUNT)),
+        .m     = m,
+        .n     = n,
+        .count = 1,
+        .lanes = COUNT
+      };
+
+      if (o.u == NULL || o.v == NULL || o.q == NULL || o.r == NULL)
+        {
+          (void)fprintf (stderr, "divmnu_bench_batch: out of memory\n");
+          kd_div_bench_free (&o);
+          return 1;
+        }
+
+      for (int k = 0; k < m * COUNT; k++)
+        o.u[k] = kd_div_random ();
+
+      for (int k = 0; k < n * COUNT; k++)
+        o.v[k] = kd_div_random () | ( k >= (n - 1) * COUNT );
+
+      for (int t = 0; t < 2; t++)
+        ns[t] = kd_div_bench_time (t == 1 ? kd_div_op_batch
+                                          : kd_div_op_batch_each, &o, NULL)
+                  / COUNT;
+
+      (void)printf ("%5d %5d %12.1f %12.1f %7.2fx\n", m, n,
+                    ns[0], ns[1], ns[0] / ns[1]);
+
+      kd_div_bench_free (&o);
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Barrett benchmark: reduction of random 2n-word numbers modulo a fixed
+ * random n-word modulus, for 256- to 4096-bit moduli, with divmnu()
+ * (remainder only; the quotient is discarded) and with
+ * divmnu_barrett_reduce(), in ns per reduction.
+ */
+
+int
+divmnu_bench_barrett (void);
+
+int
+divmnu_bench_barrett (void)
+{
+  enum { NDIVIDENDS = 64 };
+
+  (void)printf ("%5s %5s %12s %12s %8s\n", "bits", "n",
+                "divmnu", "barrett", "gain");
+
+  for (int n = 8; n <= 128; n *= 2)
+    {
+      kd_div_operands_t o;
+      divmnu_barrett_t br;
+      double ns[2];
+
+      if (!kd_div_bench_alloc (&o, "divmnu_bench_barrett", 2 * n, n,
+                               NDIVIDENDS, 0))
+        return 1;
+
+      if (divmnu_barrett_prepare (&br, o.v, n) != 0)
+        {
+          kd_div_bench_free (&o);
+          return 1;
+        }
+
+      o.arg = &br;
+      ns[0] = kd_div_bench_time (kd_div_op_divide, &o, NULL);
+      ns[1] = kd_div_bench_time (kd_div_op_barrett, &o, NULL);
+
+      (void)printf ("%5d %5d %12.1f %12.1f %7.2fx\n", 32 * n, n,
+                    ns[0], ns[1], ns[0] / ns[1]);
+
+      divmnu_barrett_release (&br);
+      kd_div_bench_free (&o);
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Modular exponentiation benchmark: g**e mod mod with e as long as mod,
+ * for 256- to 4096-bit moduli, by divmnu_modexp_ref() (a divmnu() call
+ * per product) and by divmnu_modexp() (Montgomery form), in us per
+ * exponentiation.  g is the dividend, e the divisor and mod the scratch
+ * space of a kd_div_operands_t.
+ */
+
+int
+divmnu_bench_modexp (void);
+
+int
+divmnu_bench_modexp (void)
+{
+  (void)printf ("%5s %5s %12s %12s %8s\n", "bits", "n",
+                "divmnu", "montgomery", "gain");
+
+  for (int n = 8; n <= 128; n *= 2)
+    {
+      kd_div_operands_t o;
+      double us[2];
+
+      if (!kd_div_bench_alloc (&o, "divmnu_bench_modexp", n, n, 1, n))
+        return 1;
+
+      for (int k = 0; k < n; k++)
+        o.ws[k] = kd_div_random ();
+
+      o.ws[0]     = o.ws[0] | 1;
+      o.ws[n - 1] = o.ws[n - 1] | 0x80000000;
+      o.arg       = o.ws;
+
+      us[0] = kd_div_bench_time (kd_div_op_modexp_ref, &o, NULL) / 1e3;
+      us[1] = kd_div_bench_time (kd_div_op_modexp, &o, NULL) / 1e3;
+
+      (void)printf ("%5d %5d %12.1f %12.1f %7.2fx\n", 32 * n, n,
+                    us[0], us[1], us[0] / us[1]);
+
+      kd_div_bench_free (&o);
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Burnikel-Ziegler benchmark: 2n-word by n-word divisions with divmnu()
+ * and divmnu_bz(), in us per division, over a range of sizes that shows
+ * where the recursive algorithm starts to pay off (with the current
+ * kd_div_bz_threshold and kd_div_karatsuba_threshold).
+ */
+
+int
+divmnu_bench_bz (void);
+
+int
+divmnu_bench_bz (void)
+{
+  static const int size[] = {
+    16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 1024, 2048, 4096
+  };
+
+  const int nsizes = sizeof (size) / sizeof (size[0]);
+
+  (void)printf ("bz threshold %d, karatsuba threshold %d\n",
+                kd_div_bz_threshold, kd_div_karatsuba_threshold);
+  (void)printf ("%5s %5s %12s %12s %8s\n", "m", "n",
+                "divmnu", "bz", "gain");
+
+  for (int i = 0; i < nsizes; i++)
+    {
+      const int n = size[i];
+      kd_div_operands_t o;
+      double us[2];
+
+      if (!kd_div_bench_alloc (&o, "divmnu_bench_bz", 2 * n, n, 1, 0))
+        return 1;
+
+      us[0]    = kd_div_bench_time (kd_div_op_divide, &o, NULL) / 1e3;
+      o.divide = divmnu_bz;
+      us[1]    = kd_div_bench_time (kd_div_op_divide, &o, NULL) / 1e3;
+
+      (void)printf ("%5d %5d %12.2f %12.2f %7.2fx\n", 2 * n, n,
+                    us[0], us[1], us[0] / us[1]);
+
+      kd_div_bench_free (&o);
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Newton benchmark: 2n-word by n-word divisions with divmnu_bz() and
+ * divmnu_newton(), in ms per division, for the large sizes around
+ * kd_div_newton_threshold.
+ */
+
+int
+divmnu_bench_newton (void);
+
+int
+divmnu_bench_newton (void)
+{
+  (void)printf ("newton threshold %d, ntt threshold %d\n",
+                kd_div_newton_threshold, kd_div_ntt_threshold);
+  (void)printf ("%6s %6s %10s %10s %8s\n", "m", "n", "bz", "newton",
+                "gain");
+
+  for (int n = 1024; n <= 65536; n *= 2)
+    {
+      kd_div_operands_t o;
+      double ms[2];
+
+      if (!kd_div_bench_alloc (&o, "divmnu_bench_newton", 2 * n, n, 1, 0))
+        return 1;
+
+      o.divide = divmnu_bz;
+      ms[0]    = kd_div_bench_time (kd_div_op_divide, &o, NULL) / 1e6;
+      o.divide = divmnu_newton;
+      ms[1]    = kd_div_bench_time (kd_div_op_divide, &o, NULL) / 1e6;
+
+      (void)printf ("%6d %6d %10.3f %10.3f %7.2fx\n", 2 * n, n,
+                    ms[0], ms[1], ms[0] / ms[1]);
+
+      kd_div_bench_free (&o);
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Quotient digit estimation benchmark: divide uniform and "high"
+ * operands from kd_div_generate() with each estimation, and report ns
+ * per quotient digit and, when built with -DKD_DIV_STATS, qhat
+ * adjustments and add-backs per 1000 digits, over all the divisions
+ * timed.
+ */
+
+int
+divmnu_bench_qhat (void);
+
+int
+divmnu_bench_qhat (void)
+{
+  static const struct
+  {
+    int m;
+    int n;
+  } size[] = {
+    {   8,  4 }, {  32,  8 }, {  64, 32 }, { 256, 32 }, { 512, 256 },
+  };
+
+  enum { NDIVIDENDS = 64 };
+
+  const int nsizes       = sizeof (size) / sizeof (size[0]);
+  kd_div_qhat_t qhat_was = kd_div_qhat;
+
+#ifndef KD_DIV_STATS
+  (void)printf ("(counts need -DKD_DIV_STATS)\n");
+#endif /* ifndef KD_DIV_STATS */
+
+  (void)printf ("%5s %5s %-8s %-10s %10s %10s %10s\n", "m", "n", "dist",
+                "qhat", "ns/digit", "adjust/k", "fixups/k");
+
+  for (int i = 0; i < nsizes; i++)
+    for (int d = KD_DIV_DIST_UNIFORM; d <= KD_DIV_DIST_HIGH; d++)
+      {
+        const int m = size[i].m;
+        const int n = size[i].n;
+        kd_div_operands_t o;
+
+        if (!kd_div_bench_alloc (&o, "divmnu_bench_qhat", m, n,
+                                 NDIVIDENDS, 0))
+          {
+            kd_div_qhat = qhat_was;
+            return 1;
+          }
+
+        for (int k = 0; k < NDIVIDENDS; k++)
+          kd_div_generate (&o.u[k * m], m, o.v, n, (kd_div_dist_t)d);
+
+        for (int t = 0; t < kd_div_nqhats; t++)
+          {
+            long calls;
+
+            kd_div_qhat = (kd_div_qhat_t)t;
+#ifdef KD_DIV_STATS
+            (void)memset (&kd_div_stats, 0, sizeof (kd_div_stats));
+#endif /* ifdef KD_DIV_STATS */
+
+            double ns = kd_div_bench_time (kd_div_op_divide, &o, &calls) /
+                          (m - n + 1);
+
+#ifdef KD_DIV_STATS
+            double digits = (double)calls * (m - n + 1);
+
+            (void)printf ("%5d %5d %-8s %-10s %10.2f %10.3f %10.3f\n", m, n,
+                          kd_div_dist_names[d], kd_div_qhat_names[t], ns,
+                          1e3 * (double)kd_div_stats.adjust / digits,
+                          1e3 * (double)kd_div_stats.fixups / digits);
+#else
+            (void)printf ("%5d %5d %-8s %-10s %10.2f %10s %10s\n", m, n,
+                          kd_div_dist_names[d], kd_div_qhat_names[t], ns,
+                          "-", "-");
+#endif /* ifdef KD_DIV_STATS */
+          }
+
+        kd_div_bench_free (&o);
+      }
+
+  kd_div_qhat = qhat_was;
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Short divisor benchmark: divisions by one- and two-word divisors with
+ * the paths divmnu() used before (a hardware divide per word for n = 1,
+ * and normalized copies and the selected kernel for n = 2) and with
+ * divmnu_1_preinv() and divmnu_2(), in ns per division.  divmnu() uses
+ * divmnu_1_preinv() from kd_div_preinv1_threshold words.
+ */
+
+int
+divmnu_bench_short (void);
+
+int
+divmnu_bench_short (void)
+{
+  static const int size[] = { 2, 4, 8, 16, 64, 256 };
+
+  enum { NDIVIDENDS = 64 };
+
+  const int nsizes = sizeof (size) / sizeof (size[0]);
+
+  (void)printf ("%5s %5s %12s %12s %8s\n", "m", "n", "old", "new",
+                "gain");
+
+  for (int n = 1; n <= 2; n++)
+    for (int i = 0; i < nsizes; i++)
+      {
+        const int m = size[i];
+        kd_div_operands_t o;
+        double ns[2];
+
+        /* ws: the normalized dividend and divisor of kd_div_op_2_core(). */
+
+        if (!kd_div_bench_alloc (&o, "divmnu_bench_short", m, n,
+                                 NDIVIDENDS, m + 3))
+          return 1;
+
+        ns[0] = kd_div_bench_time (n == 1 ? kd_div_op_1 : kd_div_op_2_core,
+                                   &o, NULL);
+        ns[1] = kd_div_bench_time (n == 1 ? kd_div_op_1_preinv
+                                          : kd_div_op_divide, &o, NULL);
+
+        (void)printf ("%5d %5d %12.2f %12.2f %7.2fx\n", m, n, ns[0], ns[1],
+                      ns[0] / ns[1]);
+
+        kd_div_bench_free (&o);
+      }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Exact division benchmark: divisions of products q * v by v, m words
+ * by n words, with divmnu_with_scratch() and with divmnu_exact(), in ns
+ * per division.  The scratch space holds q, then the workspace.
+ */
+
+int
+divmnu_bench_exact (void);
+
+int
+divmnu_bench_exact (void)
+{
+  static const int size[] = { 4, 16, 64, 256, 1024 };
+
+  const int nsizes = sizeof (size) / sizeof (size[0]);
+
+  (void)printf ("%5s %5s %12s %12s %8s\n", "m", "n", "divmnu", "exact",
+                "gain");
+
+  for (int i = 0; i < nsizes; i++)
+    for (int j = 0; j < nsizes; j++)
+      {
+        const int n  = size[i];
+        const int qn = size[j];
+        const int m  = qn + n;
+        int nws      = kd_div_mul_scratch (qn, n);
+        kd_div_operands_t o;
+        double ns[2];
+
+        if (nws < divmnu_scratch_words (m, n))
+          nws = (int)divmnu_scratch_words (m, n);
+
+        if (!kd_div_bench_alloc (&o, "divmnu_bench_exact", m, n, 1,
+                                 qn + nws))
+          return 1;
+
+        kd_div_operands_t e = o;
+
+        e.ws = &o.ws[qn];
+
+        for (int k = 0; k < qn; k++)
+          o.ws[k] = kd_div_random ();
+
+        kd_div_mul (o.u, o.ws, qn, o.v, n, e.ws);
+
+        ns[0] = kd_div_bench_time (kd_div_op_scratch, &e, NULL);
+        ns[1] = kd_div_bench_time (kd_div_op_exact, &e, NULL);
+
+        (void)printf ("%5d %5d %12.2f %12.2f %7.2fx\n", m, n, ns[0], ns[1],
+                      ns[0] / ns[1]);
+
+        kd_div_bench_free (&o);
+      }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Range of operand sizes, in words, for the sweep and workload
+ * benchmarks ("-r min:max"), and whether they run every kernel and
+ * quotient digit estimation or only the one named on the command line.
+ */
+
+int kd_div_bench_min  = 2;
+int kd_div_bench_max  = 10000;
+bool kd_div_bench_all = true;
+
+/****************************************************************************/
+
+/*
+ * Size sweep: for every kernel and quotient digit estimation (or only
+ * the one named on the command line), divide m-word by n-word operands
+ * for m and n on a 1-2-5 scale from kd_div_bench_min to
+ * kd_div_bench_max words, n <= m, and write one CSV line per size.
+ * Each size is warmed up, then timed in KD_DIV_SWEEP_SAMPLES samples
+ * of enough calls to last about 20 us; the median and 99th percentile
+ * of ns per call, and the median in TSC cycles per quotient word where
+ * there is a TSC, are reported.
+ */
+
+#define KD_DIV_SWEEP_SAMPLES 100
+
+/****************************************************************************/
+
+uint64_t
+kd_div_cycles (void);
+
+uint64_t
+kd_div_cycles (void)
+{
+#ifdef KD_DIV_HAVE_RDTSC
+  return __rdtsc ();
+#else
+  return 0;
+#endif /* ifdef KD_DIV_HAVE_RDTSC */
+}
+
+/****************************************************************************/
+
+int
+kd_div_cmp_double (const void *a, const void *b);
+
+int
+kd_div_cmp_double (const void *a, const void *b)
+{
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+
+  return (x > y) - (x < y);
+}
+
+/****************************************************************************/
+
+/*
+ * Next size of the 1-2-5 scale after x: 2, 5, 10, 20, 50, ...
+ */
+
+int
+kd_div_sweep_next (int x);
+
+int
+kd_div_sweep_next (int x)
+{
+  int d = 1;
+
+  while (d * 10 <= x)
+    d *= 10;
+
+  return x < 2 * d ? 2 * d : x < 5 * d ? 5 * d : 10 * d;
+}
+
+/****************************************************************************/
+
+int
+divmnu_bench_sweep (void);
+
+int
+divmnu_bench_sweep (void)
+{
+  enum { NDIVIDENDS = 16 };
+
+  const int maxm               = kd_div_bench_max;
+  const kd_div_mulsub_t mulsub = kd_div_mulsub;
+  const kd_div_qhat_t qhat     = kd_div_qhat;
+  unsigned *u = malloc (sizeof (unsigned) * (size_t)maxm * NDIVIDENDS);
+  unsigned *v = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *q = malloc (sizeof (unsigned) * (size_t)(maxm + 1));
+  unsigned *r = malloc (sizeof (unsigned) * (size_t)maxm);
+  double ns[KD_DIV_SWEEP_SAMPLES], cy[KD_DIV_SWEEP_SAMPLES];
+
+  if (u == NULL || v == NULL || q == NULL || r == NULL)
+    {
+      (void)fprintf (stderr, "divmnu_bench_sweep: out of memory\n");
+      free (u);
+      free (v);
+      free (q);
+      free (r);
+      return 1;
+    }
+
+  for (int k = 0; k < maxm * NDIVIDENDS; k++)
+    u[k] = kd_div_random ();
+
+  for (int k = 0; k < maxm; k++)
+    v[k] = kd_div_random ();
+
+#ifdef __VERSION__
+  const char *cc = __VERSION__;
+#else
+  const char *cc = "unknown";
+#endif /* ifdef __VERSION__ */
+
+  (void)printf ("kernel,qhat,m,n,calls,ns_median,ns_p99,"
+                "cycles_per_quotient_word,cc\n");
+
+  for (int j = 0; j < kd_div_nqhats; j++)
+    for (int i = 0; i < kd_div_nkernels; i++)
+      {
+        const kd_div_kernel_t *kernel = &kd_div_kernels[i];
+
+        if (!kd_div_bench_all &&
+            (kd_div_kernel_mulsub (kernel) != mulsub ||
+             (kd_div_qhat_t)j != qhat))
+          continue;
+
+        kd_div_mulsub = kd_div_kernel_mulsub (kernel);
+        kd_div_qhat   = (kd_div_qhat_t)j;
+
+        for (int n = kd_div_bench_min; n <= kd_div_bench_max;
+             n = kd_div_sweep_next (n))
+          for (int m = n; m <= kd_div_bench_max; m = kd_div_sweep_next (m))
+            {
+              /*
+               * Warm up for at least 1 ms, and size the samples from
+               * the rate seen there.
+               */
+
+              struct timespec start;
+              long calls = 0;
+
+              (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+              do
+                (void)divmnu (q, r, &u[(calls++ % NDIVIDENDS) * m], v, m, n);
+              while (kd_div_elapsed (&start) < 1e-3);
+
+              long reps = (long)(20e-6 * (double)calls /
+                                 kd_div_elapsed (&start)) + 1;
+
+              for (int t = 0; t < KD_DIV_SWEEP_SAMPLES; t++)
+                {
+                  uint64_t c0 = kd_div_cycles ();
+
+                  (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+                  for (long l = 0; l < reps; l++)
+                    (void)divmnu (q, r, &u[(l % NDIVIDENDS) * m], v, m, n);
+
+                  ns[t] = kd_div_elapsed (&start) * 1e9 / (double)reps;
+                  cy[t] = (double)(kd_div_cycles () - c0) / (double)reps;
+                }
+
+              qsort (ns, KD_DIV_SWEEP_SAMPLES, sizeof (ns[0]),
+                     kd_div_cmp_double);
+              qsort (cy, KD_DIV_SWEEP_SAMPLES, sizeof (cy[0]),
+                     kd_div_cmp_double);
+
+              (void)printf ("%s,%s,%d,%d,%ld,%.1f,%.1f,", kernel->name,
+                            kd_div_qhat_names[j], m, n,
+                            reps * KD_DIV_SWEEP_SAMPLES,
+                            ns[KD_DIV_SWEEP_SAMPLES / 2],
+                            ns[KD_DIV_SWEEP_SAMPLES * 99 / 100]);
+
+#ifdef KD_DIV_HAVE_RDTSC
+              (void)printf ("%.2f", cy[KD_DIV_SWEEP_SAMPLES / 2] /
+                                      (double)(m - n + 1));
+#endif /* ifdef KD_DIV_HAVE_RDTSC */
+
+              (void)printf (",\"%s\"\n", cc);
+              (void)fflush (stdout);
+            }
+      }
+
+  kd_div_mulsub = mulsub;
+  kd_div_qhat   = qhat;
+
+  free (u);
+  free (v);
+  free (q);
+  free (r);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Workload: for every kernel and quotient digit estimation (or only the
+ * one named on the command line) and every distribution of
+ * kd_div_generate(), divide KD_DIV_WORKLOAD_CASES operands of random
+ * sizes between kd_div_bench_min and kd_div_bench_max words, verify
+ * each result with kd_div_verify(), and report the failures and the
+ * time per quotient word.
+ */
+
+#define KD_DIV_WORKLOAD_CASES 16
+
+int
+divmnu_bench_workload (void);
+
+int
+divmnu_bench_workload (void)
+{
+  const int maxm               = kd_div_bench_max;
+  const int span               = kd_div_bench_max - kd_div_bench_min + 1;
+  const kd_div_mulsub_t mulsub = kd_div_mulsub;
+  const kd_div_qhat_t qhat     = kd_div_qhat;
+  unsigned *u  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *v  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *q  = malloc (sizeof (unsigned) * (size_t)(maxm + 1));
+  unsigned *r  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *ws = malloc (sizeof (unsigned) * (size_t)(3 * maxm + 3));
+  int failed   = 0;
+
+  if (u == NULL || v == NULL || q == NULL || r == NULL || ws == NULL)
+    {
+      (void)fprintf (stderr, "divmnu_bench_workload: out of memory\n");
+      free (u);
+      free (v);
+      free (q);
+      free (r);
+      free (ws);
+      return 1;
+    }
+
+  (void)printf ("%-35s %-8s %6s %6s %12s\n", "kernel", "dist", "cases",
+                "failed", "ns/qword");
+
+  for (int j = 0; j < kd_div_nqhats; j++)
+    for (int i = 0; i < kd_div_nkernels; i++)
+      {
+        const kd_div_kernel_t *kernel = &kd_div_kernels[i];
+        char spec[64];
+
+        if (!kd_div_bench_all &&
+            (kd_div_kernel_mulsub (kernel) != mulsub ||
+             (kd_div_qhat_t)j != qhat))
+          continue;
+
+        kd_div_mulsub = kd_div_kernel_mulsub (kernel);
+        kd_div_qhat   = (kd_div_qhat_t)j;
+
+        (void)snprintf (spec, sizeof (spec), "%s/%s", kernel->name,
+                        kd_div_qhat_names[j]);
+
+        for (int d = 0; d < kd_div_ndists; d++)
+          {
+            double seconds = 0.0, qwords = 0.0;
+            int bad        = 0;
+
+            for (int c = 0; c < KD_DIV_WORKLOAD_CASES; c++)
+              {
+                int m = kd_div_bench_min +
+                          (int)(kd_div_random () % (unsigned)span);
+                int n = kd_div_bench_min +
+                          (int)(kd_div_random () %
+                                (unsigned)(m - kd_div_bench_min + 1));
+                struct timespec start;
+
+                kd_div_generate (u, m, v, n, (kd_div_dist_t)d);
+
+                (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+                int f = divmnu (q, r, u, v, m, n);
+
+                seconds += kd_div_elapsed (&start);
+                qwords  += m - n + 1;
+
+                if (f != 0 || !kd_div_verify (q, r, u, v, m, n, ws))
+                  {
+                    (void)fprintf (stderr, "%s: %s, m = %d, n = %d: "
+                                   "q * v + r != u\n", spec,
+                                   kd_div_dist_names[d], m, n);
+                    bad++;
+                  }
+              }
+
+            (void)printf ("%-35s %-8s %6d %6d %12.2f\n", spec,
+                          kd_div_dist_names[d], KD_DIV_WORKLOAD_CASES, bad,
+                          seconds * 1e9 / qwords);
+
+            failed += bad;
+          }
+      }
+
+  kd_div_mulsub = mulsub;
+  kd_div_qhat   = qhat;
+
+  free (u);
+  free (v);
+  free (q);
+  free (r);
+  free (ws);
+
+  return failed != 0;
+}
+
+/****************************************************************************/
+
+/*
+ * SVP64 cost model: for every kernel (or only the one named on the
+ * command line), divide the same KD_DIV_WORKLOAD_CASES uniform operands
+ * of random sizes between kd_div_bench_min and kd_div_bench_max words,
+ * and report what kd_div_svp64 counted per kernel call: vector
+ * instructions, elements per vector instruction, scalar instructions
+ * and serial carry chain steps, with the last also per quotient digit.
+ * Divisors of one or two words take the fast paths, which call no
+ * kernel, so n is at least 3.  The counts are only kept when built
+ * with -DKD_DIV_SVP64.
+ */
+
+int
+divmnu_bench_svp64 (void);
+
+int
+divmnu_bench_svp64 (void)
+{
+  const int minn               = kd_div_max (kd_div_bench_min, 3);
+  const int maxm               = kd_div_max (kd_div_bench_max, minn);
+  const kd_div_mulsub_t mulsub = kd_div_mulsub;
+  const uint64_t seed          = kd_div_seed;
+  unsigned *u  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *v  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *q  = malloc (sizeof (unsigned) * (size_t)(maxm + 1));
+  unsigned *r  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *ws = malloc (sizeof (unsigned) * (size_t)(3 * maxm + 3));
+  int failed   = 0;
+
+  if (u == NULL || v == NULL || q == NULL || r == NULL || ws == NULL)
+    {
+      (void)fprintf (stderr, "divmnu_bench_svp64: out of memory\n");
+      free (u);
+      free (v);
+      free (q);
+      free (r);
+      free (ws);
+      return 1;
+    }
+
+#ifndef KD_DIV_SVP64
+  (void)printf ("(counts need -DKD_DIV_SVP64)\n");
+#endif /* ifndef KD_DIV_SVP64 */
+
+  (void)printf ("%-30s %10s %9s %9s %10s %10s %11s\n", "kernel", "calls",
+                "vec/call", "elts/vec", "scal/call", "chain/call",
+                "chain/digit");
+
+  for (int i = 0; i < kd_div_nkernels; i++)
+    {
+      const kd_div_kernel_t *kernel = &kd_div_kernels[i];
+      double digits                 = 0.0;
+
+      if (!kd_div_bench_all && kd_div_kernel_mulsub (kernel) != mulsub)
+        continue;
+
+      kd_div_mulsub = kd_div_kernel_mulsub (kernel);
+      kd_div_seed   = seed;
+#ifdef KD_DIV_SVP64
+      (void)memset (&kd_div_svp64, 0, sizeof (kd_div_svp64));
+#endif /* ifdef KD_DIV_SVP64 */
+
+      for (int c = 0; c < KD_DIV_WORKLOAD_CASES; c++)
+        {
+          int m = minn + (int)(kd_div_random () %
+                               (unsigned)(maxm - minn + 1));
+          int n = minn + (int)(kd_div_random () % (unsigned)(m - minn + 1));
+
+          kd_div_generate (u, m, v, n, KD_DIV_DIST_UNIFORM);
+
+          if (divmnu (q, r, u, v, m, n) != 0 ||
+              !kd_div_verify (q, r, u, v, m, n, ws))
+            {
+              (void)fprintf (stderr, "%s: m = %d, n = %d: q * v + r != u\n",
+                             kernel->name, m, n);
+              failed++;
+            }
+
+          digits += m - n + 1;
+        }
+
+#ifdef KD_DIV_SVP64
+      const kd_div_svp64_t *sv = &kd_div_svp64;
+      double calls = sv->calls != 0 ? (double)sv->calls : 1.0;
+
+      (void)printf ("%-30s %10lu %9.2f %9.2f %10.2f %10.2f %11.2f\n",
+                    kernel->name, sv->calls, (double)sv->vector / calls,
+                    sv->vector != 0 ? (double)sv->elements /
+                                        (double)sv->vector : 0.0,
+                    (double)sv->scalar / calls, (double)sv->chain / calls,
+                    (double)sv->chain / digits);
+#else
+      (void)digits;
+      (void)printf ("%-30s %10s %9s %9s %10s %10s %11s\n", kernel->name,
+                    "-", "-", "-", "-", "-", "-");
+#endif /* ifdef KD_DIV_SVP64 */
+    }
+
+  kd_div_mulsub = mulsub;
+  kd_div_seed   = seed;
+
+  free (u);
+  free (v);
+  free (q);
+  free (r);
+  free (ws);
+
+  return failed != 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Hardware performance counters, read with perf_event_open(2) for the
+ * calling thread in user mode: cycles, instructions, branch misses and
+ * L1D read misses.  Counters that cannot be opened (no PMU, as in most
+ * virtual machines, perf_event_paranoid, or not Linux) have a negative
+ * fd and read as zero; kd_div_perf_open() returns false, with errno
+ * set, when none could be opened.  Counts are scaled when the kernel
+ * multiplexed the counters.
+ */
+
+enum { KD_DIV_PERF_EVENTS = 4 };
+
+const char *const kd_div_perf_names[KD_DIV_PERF_EVENTS] = {
+  "cycles", "instr", "br-miss", "l1d-miss",
+};
+
+typedef struct
+{
+  int fd[KD_DIV_PERF_EVENTS];
+} kd_div_perf_t;
+
+bool
+kd_div_perf_open (kd_div_perf_t *perf);
+
+bool
+kd_div_perf_open (kd_div_perf_t *perf)
+{
+  bool any = false;
+
+  for (int i = 0; i < KD_DIV_PERF_EVENTS; i++)
+    {
+      perf->fd[i] = -1;
+
+#ifdef KD_DIV_HAVE_PERF
+      static const struct
+      {
+        uint32_t type;
+        uint32_t pad;
+        uint64_t config;
+      } event[KD_DIV_PERF_EVENTS] = {
+        { PERF_TYPE_HARDWARE, 0, PERF_COUNT_HW_CPU_CYCLES       },
+        { PERF_TYPE_HARDWARE, 0, PERF_COUNT_HW_INSTRUCTIONS     },
+        { PERF_TYPE_HARDWARE, 0, PERF_COUNT_HW_BRANCH_MISSES    },
+        { PERF_TYPE_HW_CACHE, 0, PERF_COUNT_HW_CACHE_L1D         |
+                                 PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                 PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+      };
+      struct perf_event_attr attr;
+
+      (void)memset (&attr, 0, sizeof (attr));
+      attr.size           = sizeof (attr);
+      attr.type           = event[i].type;
+      attr.config         = event[i].config;
+      attr.disabled       = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                              PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      perf->fd[i] = (int)syscall (SYS_perf_event_open, &attr, 0, -1, -1,
+                                  0UL);
+      any        |= perf->fd[i] >= 0;
+#endif /* ifdef KD_DIV_HAVE_PERF */
+    }
+
+#ifndef KD_DIV_HAVE_PERF
+  errno = ENOSYS;
+#endif /* ifndef KD_DIV_HAVE_PERF */
+
+  return any;
+}
+
+/****************************************************************************/
+
+void
+kd_div_perf_start (const kd_div_perf_t *perf);
+
+void
+kd_div_perf_start (const kd_div_perf_t *perf)
+{
+#ifdef KD_DIV_HAVE_PERF
+  for (int i = 0; i < KD_DIV_PERF_EVENTS; i++)
+    if (perf->fd[i] >= 0)
+      {
+        (void)ioctl (perf->fd[i], PERF_EVENT_IOC_RESET, 0);
+        (void)ioctl (perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+#else
+  (void)perf;
+#endif /* ifdef KD_DIV_HAVE_PERF */
+}
+
+/****************************************************************************/
+
+void
+kd_div_perf_stop (const kd_div_perf_t *perf,
+                  double count[KD_DIV_PERF_EVENTS]);
+
+void
+kd_div_perf_stop (const kd_div_perf_t *perf,
+                  double count[KD_DIV_PERF_EVENTS])
+{
+  for (int i = 0; i < KD_DIV_PERF_EVENTS; i++)
+    {
+      count[i] = 0.0;
+
+#ifdef KD_DIV_HAVE_PERF
+      uint64_t value[3];                     /* Count, enabled, running.  */
+
+      if (perf->fd[i] < 0)
+        continue;
+
+      (void)ioctl (perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+      if (read (perf->fd[i], value, sizeof (value)) != sizeof (value))
+        continue;
+
+      count[i] = (double)value[0];
+
+      if (value[2] != 0 && value[2] < value[1])
+        count[i] *= (double)value[1] / (double)value[2];
+#else
+      (void)perf;
+#endif /* ifdef KD_DIV_HAVE_PERF */
+    }
+}
+
+/****************************************************************************/
+
+void
+kd_div_perf_close (kd_div_perf_t *perf);
+
+void
+kd_div_perf_close (kd_div_perf_t *perf)
+{
+  for (int i = 0; i < KD_DIV_PERF_EVENTS; i++)
+    {
+      if (perf->fd[i] >= 0)
+        (void)close (perf->fd[i]);
+
+      perf->fd[i] = -1;
+    }
+}
+
+/****************************************************************************/
+
+/*
+ * Hardware counter benchmark: for every kernel (or only the one named
+ * on the command line), with the selected quotient digit estimation,
+ * divide uniform operands of a few sizes from kd_div_generate(), and
+ * report ns and the kd_div_perf_t counts per division and per quotient
+ * word.  Counters that are not available print as "-"; if none are,
+ * only the times are reported.
+ */
+
+int
+divmnu_bench_perf (void);
+
+int
+divmnu_bench_perf (void)
+{
+  static const struct
+  {
+    int m;
+    int n;
+  } size[] = {
+    {   8,  4 }, {  32,  8 }, {  64, 32 }, { 256, 32 }, { 512, 256 },
+  };
+
+  enum { NDIVIDENDS = 64 };
+
+  const int nsizes             = sizeof (size) / sizeof (size[0]);
+  const kd_div_mulsub_t mulsub = kd_div_mulsub;
+  kd_div_perf_t perf;
+
+  if (!kd_div_perf_open (&perf))
+    (void)printf ("(hardware counters not available: %s)\n",
+                  strerror (errno));
+
+  (void)printf ("%5s %5s %-24s %-5s %10s", "m", "n", "kernel", "per",
+                "ns");
+
+  for (int e = 0; e < KD_DIV_PERF_EVENTS; e++)
+    (void)printf (" %10s", kd_div_perf_names[e]);
+
+  (void)printf ("\n");
+
+  for (int i = 0; i < nsizes; i++)
+    {
+      const int m = size[i].m;
+      const int n = size[i].n;
+      kd_div_operands_t o;
+
+      if (!kd_div_bench_alloc (&o, "divmnu_bench_perf", m, n, NDIVIDENDS,
+                               0))
+        {
+          kd_div_mulsub = mulsub;
+          kd_div_perf_close (&perf);
+          return 1;
+        }
+
+      for (int k = 0; k < NDIVIDENDS; k++)
+        kd_div_generate (&o.u[k * m], m, o.v, n, KD_DIV_DIST_UNIFORM);
+
+      for (int t = 0; t < kd_div_nkernels; t++)
+        {
+          const kd_div_kernel_t *kernel = &kd_div_kernels[t];
+          double count[KD_DIV_PERF_EVENTS];
+          struct timespec start;
+          long calls;
+
+          if (!kd_div_bench_all && kd_div_kernel_mulsub (kernel) != mulsub)
+            continue;
+
+          kd_div_mulsub = kd_div_kernel_mulsub (kernel);
+
+          /*
+           * Count and time the same calls, the warm-up included: the
+           * ns column is their mean, not the best sample.
+           */
+
+          (void)clock_gettime (CLOCK_MONOTONIC, &start);
+          kd_div_perf_start (&perf);
+
+          (void)kd_div_bench_time (kd_div_op_divide, &o, &calls);
+
+          kd_div_perf_stop (&perf, count);
+
+          const double ns = kd_div_elapsed (&start) * 1e9 / (double)calls;
+          const double per[2]  = { 1.0, (double)(m - n + 1) };
+          const char  *name[2] = { "div", "qword" };
+
+          for (int p = 0; p < 2; p++)
+            {
+              (void)printf ("%5d %5d %-24s %-5s %10.2f", m, n, kernel->name,
+                            name[p], ns / per[p]);
+
+              for (int e = 0; e < KD_DIV_PERF_EVENTS; e++)
+                if (perf.fd[e] >= 0)
+                  (void)printf (" %10.2f",
+                                count[e] / ( (double)calls * per[p] ));
+                else
+                  (void)printf (" %10s", "-");
+
+              (void)printf ("\n");
+            }
+        }
+
+      kd_div_bench_free (&o);
+    }
+
+  kd_div_mulsub = mulsub;
+  kd_div_perf_close (&perf);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Tuning, after GMP's tuneup: "make tune" runs "divmnu -b tune", which
+ * times every kernel and quotient digit estimation, and the algorithm
+ * crossovers, on the host, and writes divmnu_tune.h (see kd_div_tune[])
+ * to standard output, with its progress on standard error.  Each time
+ * is from kd_div_bench_time(), in ns per division, over
+ * KD_DIV_TUNE_DIVIDENDS random dividends.
+ */
+
+#define KD_DIV_TUNE_DIVIDENDS 8
+
+/****************************************************************************/
+
+double
+kd_div_tune_time (kd_div_divide_t divide, unsigned q[], unsigned r[],
+                  const unsigned u[], const unsigned v[], int m, int n);
+
+double
+kd_div_tune_time (kd_div_divide_t divide, unsigned q[], unsigned r[],
+                  const unsigned u[], const unsigned v[], int m, int n)
+{
+  const kd_div_operands_t o = {
+    .u      = (unsigned *)u,
+    .v      = (unsigned *)v,
+    .q      = q,
+    .r      = r,
+    .divide = divide,
+    .m      = m,
+    .n      = n,
+    .count  = KD_DIV_TUNE_DIVIDENDS,
+    .lanes  = 1
+  };
+
+  return kd_div_bench_time (kd_div_op_divide, &o, NULL);
+}
+
+/* Same, for w = a * b with kd_div_mul(), a and b of n words. */
+
+double
+kd_div_tune_mul_time (unsigned w[], const unsigned a[], const unsigned b[],
+                      int n, unsigned ws[]);
+
+double
+kd_div_tune_mul_time (unsigned w[], const unsigned a[], const unsigned b[],
+                      int n, unsigned ws[])
+{
+  const kd_div_operands_t o = {
+    .u     = (unsigned *)a,
+    .v     = (unsigned *)b,
+    .q     = w,
+    .ws    = ws,
+    .m     = n,
+    .n     = n,
+    .count = KD_DIV_TUNE_DIVIDENDS,
+    .lanes = 1
+  };
+
+  return kd_div_bench_time (kd_div_op_mul, &o, NULL);
+}
+
+/****************************************************************************/
+
+/*
+ * Write divmnu_tune.h.  Divisors are bucketed by size up to
+ * KD_DIV_TUNE_MAXN words, each bucket timed at its largest size (the
+ * last one at KD_DIV_TUNE_MAXN) with twice as long a dividend, and
+ * adjacent buckets with the same choice are merged.  The thresholds
+ * are the first size of a grid at which the faster path wins, or twice
+ * the last size if it never does: divmnu_1_preinv() over divmnu_1() for
+ * one-word divisors; for n-word by n-word products, one level of
+ * kd_div_karatsuba() over bigmulmn(), then NTT over kd_div_karatsuba();
+ * and for 2n-word by n-word divisions, divmnu_bz(), recursing once
+ * before divmnu() with the bucket's choice, over divmnu(), then
+ * divmnu_newton() over divmnu_bz().  Each is timed with the thresholds
+ * found before it.
+ */
+
+#define KD_DIV_TUNE_MAXN 1024
+
+int
+divmnu_bench_tune (void);
+
+int
+divmnu_bench_tune (void)
+{
+  static const int bucket[] = { 4, 8, 16, 32, 64, 128, 256, 512, INT_MAX };
+  static const int preinv[] = { 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+  static const int kara[]   = {
+    8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256
+  };
+  static const int ntt[]    = {
+    256, 512, 1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384
+  };
+  static const int bz[]     = {
+    32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024
+  };
+  static const int newton[] = { 1024, 2048, 4096, 8192, 16384, 32768 };
+
+  enum
+  {
+    NBUCKETS = sizeof (bucket) / sizeof (bucket[0]),
+    NPREINV  = sizeof (preinv) / sizeof (preinv[0]),
+    NKARA    = sizeof (kara) / sizeof (kara[0]),
+    NNTT     = sizeof (ntt) / sizeof (ntt[0]),
+    NBZ      = sizeof (bz) / sizeof (bz[0]),
+    NNEWTON  = sizeof (newton) / sizeof (newton[0])
+  };
+
+  const int maxm               = 2 * newton[NNEWTON - 1];
+  const kd_div_mulsub_t mulsub = kd_div_mulsub;
+  const kd_div_qhat_t qhat     = kd_div_qhat;
+  const int preinv_was         = kd_div_preinv1_threshold;
+  const int kara_was           = kd_div_karatsuba_threshold;
+  const int ntt_was            = kd_div_ntt_threshold;
+  const int bz_was             = kd_div_bz_threshold;
+  const int nwt_was            = kd_div_newton_threshold;
+
+  /*
+   * Scratch space for the products, the most that either the deepest
+   * Karatsuba recursion or NTT takes at the largest size.
+   */
+
+  kd_div_karatsuba_threshold = 4;
+  kd_div_ntt_threshold       = INT_MAX;
+
+  const int nws = kd_div_max (kd_div_mul_scratch (ntt[NNTT - 1],
+                                                  ntt[NNTT - 1]),
+                              kd_div_ntt_scratch (2 * ntt[NNTT - 1]));
+
+  kd_div_tune_t choice[NBUCKETS];
+  unsigned *u  = malloc (sizeof (unsigned) * (size_t)maxm *
+                         KD_DIV_TUNE_DIVIDENDS);
+  unsigned *v  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *q  = malloc (sizeof (unsigned) * (size_t)(maxm + 1));
+  unsigned *r  = malloc (sizeof (unsigned) * (size_t)maxm);
+  unsigned *ws = malloc (sizeof (unsigned) * (size_t)nws);
+
+  if (u == NULL || v == NULL || q == NULL || r == NULL || ws == NULL)
+    {
+      (void)fprintf (stderr, "divmnu_bench_tune: out of memory\n");
+      free (u);
+      free (v);
+      free (q);
+      free (r);
+      free (ws);
+      kd_div_karatsuba_threshold = kara_was;
+      kd_div_ntt_threshold       = ntt_was;
+      return 1;
+    }
+
+  for (int k = 0; k < maxm * KD_DIV_TUNE_DIVIDENDS; k++)
+    u[k] = kd_div_random ();
+
+  for (int k = 0; k < maxm; k++)
+    v[k] = kd_div_random ();
+
+  /* Kernel and quotient digit estimation, per bucket. */
+
+  for (int b = 0; b < NBUCKETS; b++)
+    {
+      const int n = kd_div_max (3, b < NBUCKETS - 1 ? bucket[b]
+                                                    : KD_DIV_TUNE_MAXN);
+      double best = 0.0, kept = 0.0;
+
+      for (int j = 0; j < kd_div_nqhats; j++)
+        for (int i = 0; i < kd_div_nkernels; i++)
+          {
+            kd_div_mulsub = kd_div_kernel_mulsub (&kd_div_kernels[i]);
+            kd_div_qhat   = (kd_div_qhat_t)j;
+
+            double ns = kd_div_tune_time (divmnu, q, r, u, v, 2 * n, n);
+
+            if ( (i == 0 && j == 0) || ns < best )
+              {
+                best      = ns;
+                choice[b] = (kd_div_tune_t)
+                  {
+                    .maxn   = bucket[b],
+                    .qhat   = kd_div_qhat,
+                    .mulsub = kd_div_mulsub
+                  };
+              }
+
+            if (b > 0 && kd_div_qhat == choice[b - 1].qhat &&
+                kd_div_mulsub == choice[b - 1].mulsub)
+              kept = ns;
+          }
+
+      /*
+       * Keep the previous bucket's choice unless it is 2% slower, so
+       * that noise does not split the table.
+       */
+
+      if (b > 0 && kept != 0.0 && kept < best * 1.02)
+        {
+          choice[b] = choice[b - 1];
+          choice[b].maxn = bucket[b];
+          best           = kept;
+        }
+
+      (void)fprintf (stderr, "n = %4d: %.1f ns\n", n, best);
+    }
+
+  /* One-word divisors. */
+
+  kd_div_preinv1_threshold = INT_MAX;
+
+  for (int i = 0; i < NPREINV && kd_div_preinv1_threshold == INT_MAX; i++)
+    {
+      const int m = preinv[i];
+
+      kd_div_preinv1_threshold = m + 1;
+
+      double plain = kd_div_tune_time (divmnu, q, r, u, v, m, 1);
+
+      kd_div_preinv1_threshold = 0;
+
+      double pre = kd_div_tune_time (divmnu, q, r, u, v, m, 1);
+
+      (void)fprintf (stderr, "m = %4d, n = 1: %.1f ns, preinv %.1f ns\n",
+                     m, plain, pre);
+
+      kd_div_preinv1_threshold = pre < plain ? m : INT_MAX;
+    }
+
+  const int preinv_tuned = kd_div_preinv1_threshold == INT_MAX
+                             ? 2 * preinv[NPREINV - 1]
+                             : kd_div_preinv1_threshold;
+
+  /* Karatsuba, recursing once before bigmulmn(). */
+
+  int kara_tuned = 2 * kara[NKARA - 1];
+
+  for (int i = 0; i < NKARA; i++)
+    {
+      const int n = kara[i];
+
+      kd_div_karatsuba_threshold = n + 1;
+
+      double plain = kd_div_tune_mul_time (q, u, v, n, ws);
+
+      kd_div_karatsuba_threshold = n;
+
+      double rec = kd_div_tune_mul_time (q, u, v, n, ws);
+
+      (void)fprintf (stderr, "n = %4d x %4d: %.1f ns, karatsuba %.1f ns\n",
+                     n, n, plain, rec);
+
+      if (rec < plain)
+        {
+          kara_tuned = n;
+          break;
+        }
+    }
+
+  /* NTT, against Karatsuba's method all the way down. */
+
+  int ntt_tuned = 2 * ntt[NNTT - 1];
+
+  kd_div_karatsuba_threshold = kara_tuned;
+
+  for (int i = 0; i < NNTT; i++)
+    {
+      const int n = ntt[i];
+
+      kd_div_ntt_threshold = INT_MAX;
+
+      double rec = kd_div_tune_mul_time (q, u, v, n, ws);
+
+      kd_div_ntt_threshold = n;
+
+      double fft = kd_div_tune_mul_time (q, u, v, n, ws);
+
+      (void)fprintf (stderr, "n = %4d x %4d: karatsuba %.1f ns, "
+                     "ntt %.1f ns\n", n, n, rec, fft);
+
+      if (fft < rec)
+        {
+          ntt_tuned = n;
+          break;
+        }
+    }
+
+  kd_div_ntt_threshold = ntt_tuned;
+
+  /* Burnikel-Ziegler, with each size's kernel and estimation. */
+
+  int bz_tuned = 2 * bz[NBZ - 1];
+
+  for (int i = 0; i < NBZ; i++)
+    {
+      const int n = bz[i];
+      int b       = 0;
+
+      while (n > bucket[b])
+        b++;
+
+      kd_div_mulsub       = choice[b].mulsub;
+      kd_div_qhat         = choice[b].qhat;
+      kd_div_bz_threshold = n;
+
+      double plain = kd_div_tune_time (divmnu, q, r, u, v, 2 * n, n);
+      double rec   = kd_div_tune_time (divmnu_bz, q, r, u, v, 2 * n, n);
+
+      (void)fprintf (stderr, "m = %4d, n = %4d: %.1f ns, bz %.1f ns\n",
+                     2 * n, n, plain, rec);
+
+      if (rec < plain)
+        {
+          bz_tuned = n;
+          break;
+        }
+    }
+
+  /* Newton, against Burnikel-Ziegler, with the last bucket's choice. */
+
+  int newton_tuned = 2 * newton[NNEWTON - 1];
+
+  kd_div_mulsub       = choice[NBUCKETS - 1].mulsub;
+  kd_div_qhat         = choice[NBUCKETS - 1].qhat;
+  kd_div_bz_threshold = bz_tuned;
+
+  for (int i = 0; i < NNEWTON; i++)
+    {
+      const int n = newton[i];
+
+      double rec = kd_div_tune_time (divmnu_bz, q, r, u, v, 2 * n, n);
+      double nwt = kd_div_tune_time (divmnu_newton, q, r, u, v, 2 * n, n);
+
+      (void)fprintf (stderr, "m = %5d, n = %5d: bz %.1f ns, newton %.1f ns\n",
+                     2 * n, n, rec, nwt);
+
+      if (nwt < rec)
+        {
+          newton_tuned = n;
+          break;
+        }
+    }
+
+  kd_div_mulsub              = mulsub;
+  kd_div_qhat                = qhat;
+  kd_div_preinv1_threshold   = preinv_was;
+  kd_div_karatsuba_threshold = kara_was;
+  kd_div_ntt_threshold       = ntt_was;
+  kd_div_bz_threshold        = bz_was;
+  kd_div_newton_threshold    = nwt_was;
+
+#ifdef __VERSION__
+  const char *cc = __VERSION__;
+#else
+  const char *cc = "unknown";
+#endif /* ifdef __VERSION__ */
+
+  (void)printf ("/* Generated by \"make tune\" (divmnu -b tune), cc %s. */\n\n"
+                "#ifndef DIVMNU_TUNE_H\n#define DIVMNU_TUNE_H 1\n\n"
+                "#define KD_DIV_PREINV1_THRESHOLD   %d\n"
+                "#define KD_DIV_KARATSUBA_THRESHOLD %d\n"
+                "#define KD_DIV_NTT_THRESHOLD       %d\n"
+                "#define KD_DIV_BZ_THRESHOLD        %d\n"
+                "#define KD_DIV_NEWTON_THRESHOLD    %d\n\n"
+                "/* Longest divisor, estimation, kernel. */\n\n"
+                "#define KD_DIV_TUNE_TABLE", cc, preinv_tuned, kara_tuned,
+                ntt_tuned, bz_tuned, newton_tuned);
+
+  for (int b = 0; b < NBUCKETS; b++)
+    {
+      const kd_div_kernel_t *kernel = kd_div_kernels;
+      char maxn[16], qhat_name[32];
+
+      if (b < NBUCKETS - 1 && choice[b].qhat == choice[b + 1].qhat &&
+          choice[b].mulsub == choice[b + 1].mulsub)
+        continue;
+
+      while (kernel->mulsub != choice[b].mulsub)
+        kernel++;
+
+      if (choice[b].maxn == INT_MAX)
+        (void)snprintf (maxn, sizeof (maxn), "INT_MAX");
+      else
+        (void)snprintf (maxn, sizeof (maxn), "%d", choice[b].maxn);
+
+      (void)snprintf (qhat_name, sizeof (qhat_name), "KD_DIV_QHAT_%s,",
+                      choice[b].qhat == KD_DIV_QHAT_HWDIV ? "HWDIV"
+                        : choice[b].qhat == KD_DIV_QHAT_3BY2 ? "3BY2"
+                        : "RECIPROCAL");
+
+      (void)printf (" \\\n  { %7s, %-23s mulsub_%s },", maxn, qhat_name,
+                    kernel->name);
+    }
+
+  (void)printf ("\n\n#endif /* ifndef DIVMNU_TUNE_H */\n");
+
+  free (u);
+  free (v);
+  free (q);
+  free (r);
+  free (ws);
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Benchmarks that can be run with "divmnu -b name".
+ */
+
+typedef struct
+{
+  const char *name;
+  int       (*run) (void);
+} kd_div_bench_t;
+
+const kd_div_bench_t kd_div_benches[] = {
+  { "ctx",      divmnu_bench_ctx      },
+  { "batch",    divmnu_bench_batch    },
+  { "barrett",  divmnu_bench_barrett  },
+  { "modexp",   divmnu_bench_modexp   },
+  { "bz",       divmnu_bench_bz       },
+  { "newton",   divmnu_bench_newton   },
+  { "sweep",    divmnu_bench_sweep    },
+  { "workload", divmnu_bench_workload },
+  { "qhat",     divmnu_bench_qhat     },
+  { "short",    divmnu_bench_short    },
+  { "exact",    divmnu_bench_exact    },
+  { "svp64",    divmnu_bench_svp64    },
+  { "perf",     divmnu_bench_perf     },
+  { "tune",     divmnu_bench_tune     },
+};
+
+const int kd_div_nbenches = sizeof (kd_div_benches) /
+                              sizeof (kd_div_benches[0]);
 
-    { .m     =                        2  ,
-      .n     =                        1  ,
-      .u     = { 0xffffffff, 0xffffffff },
-      .v     = {                      1 },
-      .cq    = { 0xffffffff, 0xffffffff },
-      .cr    = {                      0 }
-    },
+/****************************************************************************/
 
-    { .m     =                        2  ,
-      .n     =                        1  ,
-      .u     = { 0xffffffff, 0xffffffff },
-      .v     = {             0xffffffff },
-      .cq    = {          1,          1 },
-      .cr    = {                      0 }
-    },
+/*
+ * Select the kernel and quotient digit estimation used by divmnu() from
+ * a "kernel[/qhat]" name (e.g. "madded_subfe/reciprocal"); the
+ * estimation defaults to "hwdiv".  Built with -DKD_DIV_TUNE, "tuned"
+ * selects the tuned dispatch (see kd_div_tune[]), and any other name
+ * deselects it.  Returns 0 for success and 2 for an unknown name.
+ */
 
-    { .m     =                        2  ,
-      .n     =                        1  ,
-      .u     = { 0xffffffff, 0xfffffffe },
-      .v     = {             0xffffffff },
-      .cq    = { 0xffffffff,          0 },
-      .cr    = {             0xfffffffe }
-    },
+int
+kd_div_select_spec (const char *spec);
 
-    { .m     =                        2  ,
-      .n     =                        1  ,
-      .u     = { 0x00005678, 0x00001234 },
-      .v     = {             0x00009abc },
-      .cq    = { 0x1e1dba76,          0 },
-      .cr    = {                 0x6bd0 }
-    },
+int
+kd_div_select_spec (const char *spec)
+{
+  char name[64];
+  const char *qhat = strchr (spec, '/');
+  size_t len       = qhat != NULL ? (size_t)(qhat - spec) : strlen (spec);
 
-    { .m     =      2  ,
-      .n     =      2  ,
-      .u     = { 0, 0 },
-      .v     = { 0, 1 },
-      .cq    = {    0 },
-      .cr    = { 0, 0 }
-    },
+  if (len >= sizeof (name))
+    len = sizeof (name) - 1;
 
-    { .m     =      2  ,
-      .n     =      2  ,
-      .u     = { 0, 7 },
-      .v     = { 0, 3 },
-      .cq    = {    2 },
-      .cr    = { 0, 1 }
-    },
+  (void)memcpy (name, spec, len);
+  name[len] = '\0';
 
-    { .m     =      2  ,
-      .n     =      2  ,
-      .u     = { 5, 7 },
-      .v     = { 0, 3 },
-      .cq    = {    2 },
-      .cr    = { 5, 1 }
-    },
+#ifdef KD_DIV_TUNE
+  kd_div_tuned = strcmp (spec, "tuned") == 0;
 
-    { .m     =      2  ,
-      .n     =      2  ,
-      .u     = { 0, 6 },
-      .v     = { 0, 2 },
-      .cq    = {    3 },
-      .cr    = { 0, 0 }
-    },
+  if (kd_div_tuned)
+    return 0;
+#endif /* ifdef KD_DIV_TUNE */
 
-    { .m     =            1  ,
-      .n     =            1  ,
-      .u     = { 0x80000000 },
-      .v     = { 0x40000001 },
-      .cq    = { 0x00000001 },
-      .cr    = { 0x3fffffff }
-    },
+  const kd_div_kernel_t *kernel = kd_div_find (name);
 
-    { .m     =                        2  ,
-      .n     =                        1  ,
-      .u     = { 0x00000000, 0x80000000 },
-      .v     = {             0x40000001 },
-      .cq    = { 0xfffffff8, 0x00000001 },
-      .cr    = {             0x00000008 }
-    },
+  if (kernel == NULL ||
+      kd_div_select_qhat (qhat != NULL ? qhat + 1 : "hwdiv") != 0)
+    {
+      (void)fprintf (stderr, "unknown kernel \"%s\"\n", spec);
+      return 2;
+    }
 
-    { .m     =                        2  ,
-      .n     =                        2  ,
-      .u     = { 0x00000000, 0x80000000 },
-      .v     = { 0x00000001, 0x40000000 },
-      .cq    = {             0x00000001 },
-      .cr    = { 0xffffffff, 0x3fffffff }
-    },
+  kd_div_mulsub = kd_div_kernel_mulsub (kernel);
 
-    { .m     =                        2  ,
-      .n     =                        2  ,
-      .u     = { 0x0000789a, 0x0000bcde },
-      .v     = { 0x0000789a, 0x0000bcde },
-      .cq    = {                      1 },
-      .cr    = {          0,          0 }
-    },
+  return 0;
+}
 
-    { .m     =                        2  ,
-      .n     =                        2  ,
-      .u     = { 0x0000789b, 0x0000bcde },
-      .v     = { 0x0000789a, 0x0000bcde },
-      .cq    = {                      1 },
-      .cr    = {          1,          0 }
-    },
+/****************************************************************************/
 
-    { .m     =                        2  ,
-      .n     =                        2  ,
-      .u     = { 0x00007899, 0x0000bcde },
-      .v     = { 0x0000789a, 0x0000bcde },
-      .cq    = {                      0 },
-      .cr    = { 0x00007899, 0x0000bcde }
-    },
+/*
+ * Run divmnu_test() with the kernel and quotient digit estimation named
+ * by spec, and print its counts when built with -DKD_DIV_STATS.
+ * Returns 0 for success, 1 for test failures and 2 for an unknown name.
+ */
 
-    { .m     =                        2  ,
-      .n     =                        2  ,
-      .u     = { 0x0000ffff, 0x0000ffff },
-      .v     = { 0x0000ffff, 0x0000ffff },
-      .cq    = {                      1 },
-      .cr    = {          0,          0 }
-    },
+int
+kd_div_run (const char *spec, bool report);
 
-    { .m     =                        2  ,
-      .n     =                        2  ,
-      .u     = { 0x0000ffff, 0x0000ffff },
-      .v     = { 0x00000000, 0x00000001 },
-      .cq    = {             0x0000ffff },
-      .cr    = { 0x0000ffff,          0 }
-    },
+int
+kd_div_run (const char *spec, bool report)
+{
+  struct timespec start;
 
-    { .m     =                                    3  ,
-      .n     =                                    2  ,
-      .u     = { 0x000089ab, 0x00004567, 0x00000123 },
-      .v     = { 0x00000000, 0x00000001             },
-      .cq    = { 0x00004567, 0x00000123             },
-      .cr    = {             0x000089ab,          0 }
-    },
+  if (kd_div_select_spec (spec) != 0)
+    return 2;
 
-    { .m     =                                    3  ,
-      .n     =                                    2  ,
-      .u     = { 0x00000000, 0x0000fffe, 0x00008000 },
-      .v     = {             0x0000ffff, 0x00008000 },
-      .cq    = {             0xffffffff, 0x00000000 },
-      .cr    = {             0x0000ffff, 0x00007fff }
-    },
+  (void)clock_gettime (CLOCK_MONOTONIC, &start);
 
-    { .m     =                                    3  ,
-      .n     =                                    3  ,
-      .u     = { 0x00000003, 0x00000000, 0x80000000 },
-      .v     = { 0x00000001, 0x00000000, 0x20000000 },
-      .cq    = {                         0x00000003 },
-      .cr    = {          0,          0, 0x20000000 }
-    },
+  int error = divmnu_test ();
 
-    { .m     =                                    3  ,
-      .n     =                                    3  ,
-      .u     = { 0x00000003, 0x00000000, 0x00008000 },
-      .v     = { 0x00000001, 0x00000000, 0x00002000 },
-      .cq    = {                         0x00000003 },
-      .cr    = {          0,          0, 0x00002000 }
-    },
+  if (report)
+    (void)printf ("%-35s %s %8.2f s %8.2f Mdiv/s\n", spec,
+                  error ? "FAILED" : "ok    ", kd_div_elapsed (&start),
+                  kd_div_rate / 1e6);
 
-    { .m     =                                                4  ,
-      .n     =                                                3  ,
-      .u     = {          0,          0, 0x00008000, 0x00007fff },
-      .v     = {                      1,          0, 0x00008000 },
-      .cq    = {                         0xfffe0000,          0 },
-      .cr    = {             0x00020000, 0xffffffff, 0x00007fff}
-    },
+#ifdef KD_DIV_STATS
+  kd_div_stats_dump (stdout, spec);
+#endif /* ifdef KD_DIV_STATS */
 
-    { .m     =                                                4  ,
-      .n     =                                                3  ,
-      .u     = {          0, 0x0000fffe,          0, 0x00008000 },
-      .v     = {             0x0000ffff,          0, 0x00008000 },
-      .cq    = {                         0xffffffff,          0 },
-      .cr    = {             0x0000ffff, 0xffffffff, 0x00007fff }
-    },
+  return error;
+}
 
-    { .m     =                                                4  ,
-      .n     =                                                3  ,
-      .u     = {          0, 0xfffffffe,          0, 0x80000000 },
-      .v     = {             0x0000ffff,          0, 0x80000000 },
-      .cq    = {                         0x00000000,          1 },
-      .cr    = {             0x00000000, 0xfffeffff, 0x00000000 }
-    },
+/****************************************************************************/
 
-    { .m     =                                                4  ,
-      .n     =                                                3  ,
-      .u     = {          0, 0xfffffffe,          0, 0x80000000 },
-      .v     = {             0xffffffff,          0, 0x80000000 },
-      .cq    = {                         0xffffffff,          0 },
-      .cr    = {             0xffffffff, 0xffffffff, 0x7fffffff }
-    },
-  };
+/*
+ * Usage: divmnu [-j threads] [kernel[/qhat] ...]
+ *        divmnu -b benchmark [-r min:max] [-s seed] [kernel[/qhat]]
+ *
+ * Runs divmnu_test() with each of the named kernels, or with every
+ * kernel in kd_div_kernels[] and every quotient digit estimation if
+ * none are named.  When more than one test is run, or -j is given, the
+ * elapsed time and divisions per second of each are printed, so the
+ * variants can be compared in one process on the same inputs.  -j sets
+ * the number of threads divmnu_test() uses (default: one per online
+ * processor).  With -b, runs one of kd_div_benches[] instead; -r sets
+ * the range of sizes, in words, of the "sweep", "workload" and
+ * "svp64" benchmarks, and -s the seed of their random operands.  Built
+ * with -DKD_DIV_STATS, the counts of each test or benchmark follow it.
+ * Built with -DKD_DIV_TUNE, the tuned dispatch is tested last, as
+ * "tuned"; the benchmarks do not use it unless it is named.
+ */
 
-  unsigned q[10], r[10];
-  const int ncases = sizeof (test) / sizeof (test[0]);
-  const long loops = 12000000L;
+int
+main (int argc, char *argv[]);
 
-  for (long l = 0L; l <= loops; l++)
-    for (int i = 0; i < ncases; i++)
-      {
-        int m        = test[i].m;
-        int n        = test[i].n;
-        uint32_t *u  = test[i].u;
-        uint32_t *v  = test[i].v;
-        uint32_t *cq = test[i].cq;
-        uint32_t *cr = test[i].cr;
+int
+main (int argc, char *argv[])
+{
+  int failed = 0;
+  int first  = 1;
 
-        int f = divmnu (q, r, u, v, m, n);
+  kd_div_select_best ();
 
-        if (f && !test[i].error)
+  if (argc > 2 && strcmp (argv[1], "-b") == 0)
+    {
+      int a = 3;
+
+#ifdef KD_DIV_TUNE
+      kd_div_tuned = false;                  /* The benchmarks select.   */
+#endif /* ifdef KD_DIV_TUNE */
+
+      for (; argc > a + 1 && argv[a][0] == '-'; a += 2)
+        if (strcmp (argv[a], "-r") == 0)
           {
-            if (l == 1)
+            if (sscanf (argv[a + 1], "%d:%d", &kd_div_bench_min,
+                        &kd_div_bench_max) != 2 ||
+                kd_div_bench_min < 1 ||
+                kd_div_bench_max < kd_div_bench_min)
               {
-                (void)fprintf (stderr, "\n\n");
-                dumpit ("FATAL: Unexpected error for dividend u =", m, u);
-                dumpit ("                            divisor  v =", n, v);
-                kd_div_errors++;
+                (void)fprintf (stderr, "%s: invalid range \"%s\"\n",
+                               argv[0], argv[a + 1]);
+
+                return 2;
               }
           }
-
-        else if (!f && test[i].error)
+        else if (strcmp (argv[a], "-s") == 0)
           {
-            if (l == 1)
+            kd_div_seed = strtoull (argv[a + 1], NULL, 0);
+
+            if (kd_div_seed == 0)
               {
-                (void)fprintf (stderr, "\n\n");
-                dumpit ("FATAL: Unexpected success for dividend u =", m, u);
-                dumpit ("                              divisor  v =", n, v);
-                kd_div_errors++;
+                (void)fprintf (stderr, "%s: invalid seed \"%s\"\n",
+                               argv[0], argv[a + 1]);
+
+                return 2;
               }
           }
+        else
+          break;
 
-        if (!f)
-          check (q, r, u, v, m, n, cq, cr, l);
-      }
+      if (argc > a)
+        {
+          if (kd_div_select_spec (argv[a]) != 0)
+            return 2;
 
-  if (kd_div_errors > 0)
-    return 1;
+          kd_div_bench_all = false;
+        }
+
+      for (int i = 0; i < kd_div_nbenches; i++)
+        if (strcmp (kd_div_benches[i].name, argv[2]) == 0)
+          {
+            int error = kd_div_benches[i].run ();
+
+#ifdef KD_DIV_STATS
+            kd_div_stats_dump (stdout, argv[2]);
+#endif /* ifdef KD_DIV_STATS */
+
+            return error;
+          }
+
+      (void)fprintf (stderr, "%s: unknown benchmark \"%s\"\n",
+                     argv[0], argv[2]);
+
+      return 2;
+    }
+
+  if (argc > 2 && strcmp (argv[1], "-j") == 0)
+    {
+      kd_div_threads = atoi (argv[2]);
+      first          = 3;
+
+      if (kd_div_threads <= 0)
+        {
+          (void)fprintf (stderr, "%s: invalid thread count \"%s\"\n",
+                         argv[0], argv[2]);
+
+          return 2;
+        }
+    }
+
+  if (argc > first)
+    {
+      for (int i = first; i < argc; i++)
+        {
+          int error = kd_div_run (argv[i], argc > 2);
+
+          if (error == 2)
+            return 2;
+
+          failed += error;
+        }
+    }
   else
-    return 0;
-}
+    {
+      for (int j = 0; j < kd_div_nqhats; j++)
+        for (int i = 0; i < kd_div_nkernels; i++)
+          {
+            char spec[64];
 
-/****************************************************************************/
+            (void)snprintf (spec, sizeof (spec), "%s/%s",
+                            kd_div_kernels[i].name, kd_div_qhat_names[j]);
 
-int
-main (void);
+            failed += kd_div_run (spec, true);
+          }
 
-int
-main (void)
-{
-  return divmnu_test();
+#ifdef KD_DIV_TUNE
+      failed += kd_div_run ("tuned", true);
+#endif /* ifdef KD_DIV_TUNE */
+    }
+
+  return failed != 0;
 }
+
+/****************************************************************************/
+
+#endif /* ifndef KD_DIV_LIBRARY */
@@ -0,0 +1,215 @@
+/* vim: set ts=4 sw=4 tw=0 cc=79 et : */
+
+/****************************************************************************/
+
+/*
+ * Public interface of libdivmnu: multiword division with 32-bit words
+ * (base 2**32), least significant word first.  See divmnu.c for the
+ * requirements on each operand; in short, a divisor v of n words needs
+ * v[n-1] != 0, a dividend u of m words needs m >= n, the quotient has
+ * m - n + 1 words and the remainder n.  Functions returning int return
+ * 0 for success, 1 for invalid parameters and 2 if out of memory.
+ */
+
+#ifndef DIVMNU_H
+#define DIVMNU_H 1
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && !defined(__COMPCERT__)
+# define DIVMNU_API __attribute__ ( (visibility ("default")) )
+#else
+# define DIVMNU_API
+#endif /* if defined(__GNUC__) && !defined(__COMPCERT__) */
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* ifdef __cplusplus */
+
+/****************************************************************************/
+
+/*
+ * Divisor context.  Everything divmnu() computes from the divisor alone
+ * (the normalization shift, the normalized divisor, the reciprocals of
+ * its top digit and top two digits, and the kernel and quotient digit
+ * estimation to use for its length) is kept here, so that repeated
+ * divisions by the same divisor can be done by divmnu_with_ctx()
+ * without redoing it.
+ */
+
+typedef struct
+{
+  int       n;                               /* Divisor length in words.  */
+  int       s;                               /* Normalization shift.      */
+  unsigned *vn;                              /* Normalized divisor.       */
+  uint32_t  vinv;                            /* Reciprocal of vn[n-1].    */
+  uint32_t  vinv3;                           /* Same, of vn[n-1..n-2].    */
+  bool    (*mulsub) (uint32_t qhat, unsigned un_j[], unsigned vn[],
+                     int n);                 /* Multiply-and-subtract.    */
+  int       qhat;                            /* Quotient digit estimate.  */
+  bool      owned;                           /* vn allocated by prepare.  */
+  char      pad[3];
+} divmnu_ctx_t;
+
+/*
+ * Streaming division, for the quotient words passed to the emit
+ * callback: called with the next nq quotient words, q[nq - 1] the most
+ * significant, which go just below those passed before.
+ */
+
+typedef void (*divmnu_emit_t) (void *arg, const unsigned q[], int nq);
+
+typedef struct
+{
+  divmnu_ctx_t   ctx;                        /* The divisor.              */
+  divmnu_emit_t  emit;                       /* Quotient callback.        */
+  void          *arg;                        /* Passed to emit.           */
+  unsigned      *win;                        /* Chunk, then remainder.    */
+  unsigned      *q;                          /* Quotient of the chunk.    */
+  long           nw;                         /* Normalized words so far.  */
+  unsigned       last;                       /* Last dividend word fed.   */
+  int            fill;                       /* Words in the chunk.       */
+} divmnu_stream_t;
+
+/* Barrett reduction by a fixed modulus. */
+
+typedef struct
+{
+  int       n;                               /* Modulus length in words.  */
+  int       pad;
+  unsigned *v;                               /* Modulus, n + 1 words.     */
+  unsigned *mu;                              /* b**(2n) / v, n + 2 words. */
+  unsigned *ws;                              /* Scratch, 3n + 6 words.    */
+} divmnu_barrett_t;
+
+/* Montgomery arithmetic modulo an odd modulus. */
+
+typedef struct
+{
+  int       n;                               /* Modulus length in words.  */
+  uint32_t  minv;                            /* -mod**-1 mod b.           */
+  unsigned *mod;                             /* Modulus, n + 1 words.     */
+  unsigned *one;                             /* R mod mod, n words.       */
+} divmnu_mont_t;
+
+/****************************************************************************/
+
+/* Knuth's Algorithm D, with the scratch space allocated or supplied. */
+
+DIVMNU_API int
+divmnu (unsigned q[], unsigned r[], const unsigned u[], const unsigned v[],
+        int m, int n);
+
+DIVMNU_API long
+divmnu_scratch_words (int m, int n);
+
+DIVMNU_API int
+divmnu_with_scratch (unsigned q[], unsigned r[], const unsigned u[],
+                     const unsigned v[], int m, int n, unsigned ws[]);
+
+DIVMNU_API int
+divmnu_in_place (unsigned q[], unsigned r[], unsigned u[],
+                 const unsigned v[], int m, int n, unsigned ws[]);
+
+/* Repeated division by one divisor. */
+
+DIVMNU_API int
+divmnu_prepare (divmnu_ctx_t *ctx, const unsigned v[], int n);
+
+DIVMNU_API void
+divmnu_release (divmnu_ctx_t *ctx);
+
+DIVMNU_API int
+divmnu_with_ctx_scratch (unsigned q[], unsigned r[], const unsigned u[],
+                         int m, const divmnu_ctx_t *ctx, unsigned ws[]);
+
+DIVMNU_API int
+divmnu_with_ctx (unsigned q[], unsigned r[], const unsigned u[], int m,
+                 const divmnu_ctx_t *ctx);
+
+/* Exact division (u a multiple of v). */
+
+DIVMNU_API int
+divmnu_exact (unsigned q[], const unsigned u[], const unsigned v[], int m,
+              int n, unsigned ws[]);
+
+/* Streaming division, from memory or from a file. */
+
+DIVMNU_API int
+divmnu_stream_open (divmnu_stream_t *st, const unsigned v[], int n,
+                    divmnu_emit_t emit, void *arg);
+
+DIVMNU_API void
+divmnu_stream_feed (divmnu_stream_t *st, const unsigned u[], long k);
+
+DIVMNU_API int
+divmnu_stream_close (divmnu_stream_t *st, unsigned r[]);
+
+DIVMNU_API int
+divmnu_file (const char *upath, const char *qpath, unsigned r[],
+             const unsigned v[], int n);
+
+/* Barrett reduction. */
+
+DIVMNU_API int
+divmnu_barrett_prepare (divmnu_barrett_t *br, const unsigned v[], int n);
+
+DIVMNU_API void
+divmnu_barrett_release (divmnu_barrett_t *br);
+
+DIVMNU_API void
+divmnu_barrett_reduce (unsigned r[], const unsigned x[],
+                       const divmnu_barrett_t *br);
+
+/* Montgomery arithmetic and modular exponentiation. */
+
+DIVMNU_API int
+divmnu_mont_prepare (divmnu_mont_t *mt, const unsigned mod[], int n);
+
+DIVMNU_API void
+divmnu_mont_release (divmnu_mont_t *mt);
+
+DIVMNU_API void
+divmnu_mont_mul (unsigned r[], const unsigned a[], const unsigned b[],
+                 const divmnu_mont_t *mt, unsigned t[]);
+
+DIVMNU_API int
+divmnu_mont_enter (unsigned r[], const unsigned a[], int na,
+                   const divmnu_mont_t *mt);
+
+DIVMNU_API void
+divmnu_mont_leave (unsigned r[], const unsigned a[], const divmnu_mont_t *mt,
+                   unsigned t[]);
+
+DIVMNU_API int
+divmnu_modexp (unsigned r[], const unsigned g[], int ng, const unsigned e[],
+               int ne, const unsigned mod[], int n);
+
+/* Subquadratic division, and the choice between the algorithms. */
+
+DIVMNU_API int
+divmnu_bz (unsigned q[], unsigned r[], const unsigned u[],
+           const unsigned v[], int m, int n);
+
+DIVMNU_API int
+divmnu_newton (unsigned q[], unsigned r[], const unsigned u[],
+               const unsigned v[], int m, int n);
+
+DIVMNU_API int
+divmnu_auto (unsigned q[], unsigned r[], const unsigned u[],
+             const unsigned v[], int m, int n);
+
+/* count problems of the same sizes, stored interleaved. */
+
+DIVMNU_API int
+divmnu_batch (unsigned q[], unsigned r[], const unsigned u[],
+              const unsigned v[], int m, int n, int count);
+
+/****************************************************************************/
+
+#ifdef __cplusplus
+}
+#endif /* ifdef __cplusplus */
+
+#endif /* ifndef DIVMNU_H */
@@ -0,0 +1,1533 @@
+/* vim: set ts=4 sw=4 tw=0 cc=79 et : */
+
+/****************************************************************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/****************************************************************************/
+
+#ifndef __SIZEOF_INT128__
+# error divmnu64 requires a compiler with unsigned __int128 support!
+#endif /* ifndef __SIZEOF_INT128__ */
+
+typedef unsigned __int128 uint128_t;
+typedef          __int128  int128_t;
+
+/****************************************************************************/
+
+#define kd_div_max(x, y) ( (x) > (y) ? (x) : (y) )
+
+/****************************************************************************/
+
+int
+nlz64 (uint64_t x);
+
+int
+nlz64 (uint64_t x)
+{
+  int n;
+
+  if (x == 0)
+    return (64);
+
+  n = 0;
+
+  if (x <= 0x00000000FFFFFFFFULL)
+    {
+      n = n  + 32;
+      x = x << 32;
+    }
+
+  if (x <= 0x0000FFFFFFFFFFFFULL)
+    {
+      n = n  + 16;
+      x = x << 16;
+    }
+
+  if (x <= 0x00FFFFFFFFFFFFFFULL)
+    {
+      n = n  + 8;
+      x = x << 8;
+    }
+
+  if (x <= 0x0FFFFFFFFFFFFFFFULL)
+    {
+      n = n  + 4;
+      x = x << 4;
+    }
+
+  if (x <= 0x3FFFFFFFFFFFFFFFULL)
+    {
+      n = n  + 2;
+      x = x << 2;
+    }
+
+  if (x <= 0x7FFFFFFFFFFFFFFFULL)
+    {
+      n = n + 1;
+    }
+
+  return n;
+}
+
+/****************************************************************************/
+
+void
+dumpit64 (char *msg, int n, uint64_t v[]);
+
+void
+dumpit64 (char *msg, int n, uint64_t v[])
+{
+  int i;
+
+  (void)fprintf (stderr, "%s", msg);
+
+  for (i = n - 1; i >= 0; i--)
+    (void)fprintf (stderr, " %016llX", (unsigned long long)v[i]);
+
+  (void)fprintf (stderr, "\n");
+}
+
+/****************************************************************************/
+
+typedef struct
+{
+  uint64_t q;
+  uint64_t r;
+  bool overflow;
+  char pad[7];
+} divrem64_t;
+
+divrem64_t
+divrem_128_by_64 (uint128_t n, uint64_t d);
+
+divrem64_t
+divrem_128_by_64 (uint128_t n, uint64_t d)
+{
+  if ( (n >> 64) >= d )
+      /* overflow */
+    {
+      return (divrem64_t)
+        {
+          .q        = UINT64_MAX,
+          .r        = 0,
+          .overflow = true
+        };
+    }
+  else
+    {
+      return (divrem64_t)
+        {
+          .q        = (uint64_t)(n / d),
+          .r        = (uint64_t)(n % d),
+          .overflow = false
+        };
+    }
+}
+
+/****************************************************************************/
+
+bool
+bigmul64 (uint64_t qhat, uint64_t product[], uint64_t vn[],
+          int m, int n);
+
+bool
+bigmul64 (uint64_t qhat, uint64_t product[], uint64_t vn[],
+          int m, int n)
+{
+  (void)qhat;
+  (void)product;
+  (void)vn;
+  (void)m;
+  (void)n;
+
+  uint64_t carry = 0;
+
+  /* VL = n + 1 */
+  /* sv.madded product.v, vn.v, qhat.s, carry.s */
+
+  for (int i = 0; i <= n; i++)
+    {
+      uint64_t  vn_v  = i < n ? vn[i] : 0;
+      uint128_t value = (uint128_t)vn_v * (uint128_t)qhat + carry;
+      carry           = (uint64_t)(value >> 64);
+      product[i]      = (uint64_t)value;
+    }
+
+  return carry != 0;
+}
+
+/****************************************************************************/
+
+bool
+bigadd64 (uint64_t result[], uint64_t vn[], uint64_t un[],
+          int m, int n, bool ca);
+
+bool
+bigadd64 (uint64_t result[], uint64_t vn[], uint64_t un[],
+          int m, int n, bool ca)
+{
+  (void)result;
+  (void)vn;
+  (void)un;
+  (void)m;
+  (void)n;
+  (void)ca;
+
+  /* VL = n + 1 */
+  /* sv.subfe un_j.v, product.v, un_j.v */
+
+  for (int i = 0; i <= n; i++)
+    {
+      uint128_t value = (uint128_t)vn[i] + (uint128_t)un[i] + ca;
+      ca              = value >> 64 != 0;
+      result[i]       = (uint64_t)value;
+    }
+
+  return ca;
+}
+
+/****************************************************************************/
+
+bool
+bigsub64 (uint64_t result[], uint64_t vn[], uint64_t un[],
+          int m, int n, bool ca);
+
+bool
+bigsub64 (uint64_t result[], uint64_t vn[], uint64_t un[],
+          int m, int n, bool ca)
+{
+  (void)result;
+  (void)vn;
+  (void)un;
+  (void)m;
+  (void)n;
+  (void)ca;
+
+  /* VL = n + 1 */
+  /* sv.subfe un_j.v, product.v, un_j.v */
+
+  for (int i = 0; i <= n; i++)
+    {
+      uint128_t value = (uint128_t) ~vn[i] + (uint128_t)un[i] + ca;
+      ca              = value >> 64 != 0;
+      result[i]       = (uint64_t)value;
+    }
+
+  return ca;
+}
+
+/****************************************************************************/
+
+bool
+bigmulsub64 (uint64_t qhat, uint64_t vn[], uint64_t un[],
+             int j, int m, int n);
+
+bool
+bigmulsub64 (uint64_t qhat, uint64_t vn[], uint64_t un[],
+             int j, int m, int n)
+{
+  (void)qhat;
+  (void)vn;
+  (void)un;
+  (void)j;
+  (void)m;
+  (void)n;
+
+  /* Multiply and subtract. */
+
+  uint64_t product[n + 1];
+
+  (void)bigmul64 (qhat, product, vn, m, n);
+
+  bool ca         = bigsub64 (un, product, un, m, n, true);
+  bool need_fixup = !ca;
+
+  return need_fixup;
+}
+
+/****************************************************************************/
+
+/*
+ * Multiply-and-subtract kernels; the base 2**64 counterparts of the
+ * mulsub_*() kernels in divmnu.c.
+ */
+
+typedef bool (*kd_div64_mulsub_t) (uint64_t qhat, uint64_t un_j[],
+                                   uint64_t vn[], int n);
+
+/****************************************************************************/
+
+bool
+mulsub64_original (uint64_t qhat, uint64_t un_j[],
+                   uint64_t vn[], int n);
+
+bool
+mulsub64_original (uint64_t qhat, uint64_t un_j[],
+                   uint64_t vn[], int n)
+{
+  uint128_t p;                               /* Product of two digits.    */
+  int128_t  k, t;
+  int i;
+
+  k = 0;
+
+  for (i = 0; i < n; i++)
+    {
+      p = (uint64_t)qhat * (uint128_t)vn[i];
+
+      t = (int128_t)( (int128_t)un_j[i] -
+             (int128_t)k -
+             (int128_t)(p & 0xFFFFFFFFFFFFFFFFULL) );
+
+      un_j[i] = (uint64_t)t;
+
+      k  = (int128_t)( (int128_t)(p >> 64) -
+             (int128_t)(t >> 64) );
+    }
+
+  t       = un_j[n] - k;
+  un_j[n] = (uint64_t)t;
+
+  return t < 0;
+}
+
+/****************************************************************************/
+
+bool
+mulsub64_sub_mul_borrow (uint64_t qhat, uint64_t un_j[],
+                         uint64_t vn[], int n);
+
+bool
+mulsub64_sub_mul_borrow (uint64_t qhat, uint64_t un_j[],
+                         uint64_t vn[], int n)
+{
+  uint64_t borrow = 0;
+
+  for (int ii = 0; ii <= n; ii++)
+    {
+      uint64_t  vn_i  = ii < n ? vn[ii] : 0;
+      uint128_t value = un_j[ii] - (uint128_t)qhat * vn_i - borrow;
+      borrow          = -(uint64_t)(value >> 64);
+      un_j[ii]        = (uint64_t)value;
+    }
+
+  return borrow != 0;
+}
+
+/****************************************************************************/
+
+bool
+mulsub64_mul_rsub_carry (uint64_t qhat, uint64_t un_j[],
+                         uint64_t vn[], int n);
+
+bool
+mulsub64_mul_rsub_carry (uint64_t qhat, uint64_t un_j[],
+                         uint64_t vn[], int n)
+{
+  uint64_t carry = 1;
+
+  for (int ii = 0; ii <= n; ii++)
+    {
+      uint64_t  vn_i   = ii < n ? vn[ii] : 0;
+      uint128_t result = un_j[ii] +
+                           ~( (uint128_t)qhat * vn_i ) +
+                           carry;
+
+      uint64_t result_high = (uint64_t)(result >> 64);
+
+      if (carry <= 1)
+        result_high++;
+
+      carry    = result_high;
+      un_j[ii] = (uint64_t)result;
+    }
+
+  return carry != 1;
+}
+
+/****************************************************************************/
+
+/*
+ * As in divmnu.c, the two-stage kernels run both stages over blocks of
+ * KD_DIV64_STAGE words, small enough for phi and plo to stay in
+ * registers and for the first stage of the next block to overlap the
+ * chained second stage of this one, then the last words one at a time.
+ */
+
+#define KD_DIV64_STAGE 2
+
+bool
+mulsub64_sub_mul_borrow_2stage (uint64_t qhat, uint64_t un_j[],
+                                uint64_t vn[], int n);
+
+bool
+mulsub64_sub_mul_borrow_2stage (uint64_t qhat, uint64_t un_j[],
+                                uint64_t vn[], int n)
+{
+  uint64_t borrow = 0;
+  uint64_t phi[KD_DIV64_STAGE];
+  uint64_t plo[KD_DIV64_STAGE];
+  int s0;
+
+  for (s0 = 0; s0 + KD_DIV64_STAGE <= n; s0 += KD_DIV64_STAGE)
+    {
+      /*
+       * First, perform mul-and-sub and store in split hi-lo
+       * this shows the vectorised sv.msubx which stores 128-bit in
+       * two 64-bit registers
+       */
+
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t value = un_j[s0 + k] - (uint128_t)qhat * vn[s0 + k];
+          plo[k]          = (uint64_t)value;
+          phi[k]          = (uint64_t)(value >> 64);
+        }
+
+      /*
+       * Second, reconstruct the 128-bit result, subtract borrow,
+       * store top-half (-ve) in new borrow and store low-half as answer
+       * this is the new (odd) instruction
+       */
+
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t value = ( ( (uint128_t)phi[k] << 64 ) | plo[k] ) -
+                              borrow;
+          borrow          = ~(uint64_t)(value >> 64) + 1;
+          un_j[s0 + k]    = (uint64_t)value;
+        }
+    }
+
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint64_t  vn_i  = ii < n ? vn[ii] : 0;
+      uint128_t value = un_j[ii] - (uint128_t)qhat * vn_i;
+      plo[0]          = (uint64_t)value;
+      phi[0]          = (uint64_t)(value >> 64);
+
+      value    = ( ( (uint128_t)phi[0] << 64 ) | plo[0] ) - borrow;
+      borrow   = ~(uint64_t)(value >> 64) + 1;
+      un_j[ii] = (uint64_t)value;
+    }
+
+  return borrow != 0;
+}
+
+/****************************************************************************/
+
+bool
+mulsub64_mul_rsub_carry_2stage_0 (uint64_t qhat, uint64_t un_j[],
+                                  uint64_t vn[], int n);
+
+bool
+mulsub64_mul_rsub_carry_2stage_0 (uint64_t qhat, uint64_t un_j[],
+                                  uint64_t vn[], int n)
+{
+  uint64_t carry = 1;
+  uint64_t phi[KD_DIV64_STAGE];
+  uint64_t plo[KD_DIV64_STAGE];
+  int s0;
+
+  for (s0 = 0; s0 + KD_DIV64_STAGE <= n; s0 += KD_DIV64_STAGE)
+    {
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t value = un_j[s0 + k] + ~( (uint128_t)qhat * vn[s0 + k] );
+          plo[k]          = (uint64_t)value;
+          phi[k]          = (uint64_t)(value >> 64);
+        }
+
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t result = ( ( (uint128_t)phi[k] << 64 ) | plo[k] ) +
+                               carry;
+
+          uint64_t result_high = (uint64_t)(result >> 64);
+
+          if (carry <= 1)
+            result_high++;
+
+          carry        = result_high;
+          un_j[s0 + k] = (uint64_t)result;
+        }
+    }
+
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint64_t  vn_i  = ii < n ? vn[ii] : 0;
+      uint128_t value = un_j[ii] + ~( (uint128_t)qhat * vn_i );
+      plo[0]          = (uint64_t)value;
+      phi[0]          = (uint64_t)(value >> 64);
+
+      uint128_t result = ( ( (uint128_t)phi[0] << 64 ) | plo[0] ) + carry;
+
+      uint64_t result_high = (uint64_t)(result >> 64);
+
+      if (carry <= 1)
+        result_high++;
+
+      carry    = result_high;
+      un_j[ii] = (uint64_t)result;
+    }
+
+  return carry != 1;
+}
+
+/****************************************************************************/
+
+bool
+mulsub64_mul_rsub_carry_2stage_1 (uint64_t qhat, uint64_t un_j[],
+                                  uint64_t vn[], int n);
+
+bool
+mulsub64_mul_rsub_carry_2stage_1 (uint64_t qhat, uint64_t un_j[],
+                                  uint64_t vn[], int n)
+{
+  uint64_t carry = 1;
+  uint64_t phi[KD_DIV64_STAGE];
+  uint64_t plo[KD_DIV64_STAGE];
+  int s0;
+
+  for (s0 = 0; s0 + KD_DIV64_STAGE <= n; s0 += KD_DIV64_STAGE)
+    {
+      /*
+       * Same mul-and-sub as SUB_MUL_BORROW but not the same
+       * mul-and-sub-minus-one as MUL_RSUB_CARRY
+       */
+
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t value = un_j[s0 + k] - ( (uint128_t)qhat * vn[s0 + k] );
+          plo[k]          = (uint64_t)value;
+          phi[k]          = (uint64_t)(value >> 64);
+        }
+
+      /*
+       * Compensate for the +1 that was added by mul-and-sub
+       * by subtracting it here ( as ~(0) ).
+       */
+
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t result = (uint128_t)( ( ( (uint128_t)phi[k] << 64 ) |
+                               (uint128_t)plo[k] ) +
+                               (uint128_t)carry +
+                               ~(uint128_t)0 );  /* i.e. "-1" */
+
+          uint64_t result_high = (uint64_t)(result >> 64);
+
+          if (carry <= 1)
+            result_high++;
+
+          carry        = result_high;
+          un_j[s0 + k] = (uint64_t)result;
+        }
+    }
+
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint64_t  vn_i  = ii < n ? vn[ii] : 0;
+      uint128_t value = un_j[ii] - ( (uint128_t)qhat * vn_i );
+      plo[0]          = (uint64_t)value;
+      phi[0]          = (uint64_t)(value >> 64);
+
+      uint128_t result = (uint128_t)( ( ( (uint128_t)phi[0] << 64 ) |
+                           (uint128_t)plo[0] ) +
+                           (uint128_t)carry +
+                           ~(uint128_t)0 );  /* i.e. "-1" */
+
+      uint64_t result_high = (uint64_t)(result >> 64);
+
+      if (carry <= 1)
+        result_high++;
+
+      carry    = result_high;
+      un_j[ii] = (uint64_t)result;
+    }
+
+  return carry != 1;
+}
+
+/****************************************************************************/
+
+bool
+mulsub64_mul_rsub_carry_2stage_2 (uint64_t qhat, uint64_t un_j[],
+                                  uint64_t vn[], int n);
+
+bool
+mulsub64_mul_rsub_carry_2stage_2 (uint64_t qhat, uint64_t un_j[],
+                                  uint64_t vn[], int n)
+{
+  uint64_t carry = 0;
+  uint64_t phi[KD_DIV64_STAGE];
+  uint64_t plo[KD_DIV64_STAGE];
+  int s0;
+
+  for (s0 = 0; s0 + KD_DIV64_STAGE <= n; s0 += KD_DIV64_STAGE)
+    {
+      /*
+       * Same mul-and-sub as SUB_MUL_BORROW but not the same
+       * mul-and-sub-minus-one as MUL_RSUB_CARRY
+       */
+
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t value = un_j[s0 + k] - ( (uint128_t)qhat * vn[s0 + k] );
+          plo[k]          = (uint64_t)value;
+          phi[k]          = (uint64_t)(value >> 64);
+        }
+
+      for (int k = 0; k < KD_DIV64_STAGE; k++)
+        {
+          uint128_t result = ( ( (uint128_t)phi[k] << 64 ) | plo[k] ) +
+                               carry;
+
+          uint64_t result_high = (uint64_t)(result >> 64);
+
+          if (carry == 0)
+            carry = result_high;
+          else
+            carry = result_high - 1;
+
+          un_j[s0 + k] = (uint64_t)result;
+        }
+    }
+
+  for (int ii = s0; ii <= n; ii++)
+    {
+      uint64_t  vn_i  = ii < n ? vn[ii] : 0;
+      uint128_t value = un_j[ii] - ( (uint128_t)qhat * vn_i );
+      plo[0]          = (uint64_t)value;
+      phi[0]          = (uint64_t)(value >> 64);
+
+      uint128_t result = ( ( (uint128_t)phi[0] << 64 ) | plo[0] ) + carry;
+
+      uint64_t result_high = (uint64_t)(result >> 64);
+
+      if (carry == 0)
+        carry = result_high;
+      else
+        carry = result_high - 1;
+
+      un_j[ii] = (uint64_t)result;
+    }
+
+  return carry != 0;
+}
+
+/****************************************************************************/
+
+bool
+mulsub64_madded_subfe (uint64_t qhat, uint64_t un_j[],
+                       uint64_t vn[], int n);
+
+bool
+mulsub64_madded_subfe (uint64_t qhat, uint64_t un_j[],
+                       uint64_t vn[], int n)
+{
+  uint64_t carry = 0;
+  uint64_t product[n + 1];
+
+  /* VL = n + 1 */
+  /* sv.madded product.v, vn.v, qhat.s, carry.s */
+
+  for (int ii = 0; ii <= n; ii++)
+    {
+      uint64_t  vn_v  = ii < n ? vn[ii] : 0;
+      uint128_t value = (uint128_t)vn_v * (uint128_t)qhat + carry;
+      carry           = (uint64_t)(value >> 64);
+      product[ii]     = (uint64_t)value;
+    }
+
+  bool ca = true;
+
+  /* VL = n + 1 */
+  /* sv.subfe un_j.v, product.v, un_j.v */
+
+  for (int ii = 0; ii <= n; ii++)
+    {
+      uint128_t value = (uint128_t) ~product[ii] + (uint128_t)un_j[ii] + ca;
+      ca              = value >> 64 != 0;
+      un_j[ii]        = (uint64_t)value;
+    }
+
+  return !ca;
+}
+
+/****************************************************************************/
+
+/*
+ * Kernel dispatch table.  The names match the suffixes of the old
+ * per-variant executables (divmnu64-original, divmnu64-madded_subfe, ...).
+ */
+
+typedef struct
+{
+  const char        *name;
+  kd_div64_mulsub_t  mulsub;
+} kd_div64_kernel_t;
+
+const kd_div64_kernel_t kd_div64_kernels[] = {
+  { "original",                mulsub64_original                },
+  { "sub_mul_borrow",          mulsub64_sub_mul_borrow          },
+  { "mul_rsub_carry",          mulsub64_mul_rsub_carry          },
+  { "sub_mul_borrow_2stage",   mulsub64_sub_mul_borrow_2stage   },
+  { "mul_rsub_carry_2stage_0", mulsub64_mul_rsub_carry_2stage_0 },
+  { "mul_rsub_carry_2stage_1", mulsub64_mul_rsub_carry_2stage_1 },
+  { "mul_rsub_carry_2stage_2", mulsub64_mul_rsub_carry_2stage_2 },
+  { "madded_subfe",            mulsub64_madded_subfe            },
+};
+
+const int kd_div64_nkernels = sizeof (kd_div64_kernels) /
+                                sizeof (kd_div64_kernels[0]);
+
+/* Kernel used by divmnu64(); see kd_div64_select(). */
+
+kd_div64_mulsub_t kd_div64_mulsub = mulsub64_original;
+
+/****************************************************************************/
+
+const kd_div64_kernel_t *
+kd_div64_find (const char *name);
+
+const kd_div64_kernel_t *
+kd_div64_find (const char *name)
+{
+  for (int i = 0; i < kd_div64_nkernels; i++)
+    if (strcmp (kd_div64_kernels[i].name, name) == 0)
+      return &kd_div64_kernels[i];
+
+  return NULL;
+}
+
+/****************************************************************************/
+
+/*
+ * Select the kernel used by divmnu64() by name.  Returns 0 for success
+ * and 1 if there is no kernel of that name, in which case the current
+ * selection is left unchanged.
+ */
+
+int
+kd_div64_select (const char *name);
+
+int
+kd_div64_select (const char *name)
+{
+  const kd_div64_kernel_t *kernel = kd_div64_find (name);
+
+  if (kernel == NULL)
+    return 1;
+
+  kd_div64_mulsub = kernel->mulsub;
+
+  return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * q[0], r[0], u[0], and v[0] contain the LEAST significant words.
+ * (The sequence is in little-endian order).
+ *
+ * This is the same implementation of Knuth's Algorithm D as divmnu()
+ * in divmnu.c, but for base b = 2**64. The two-digit quantities (dig2,
+ * qhat, rhat and the digit products) are carried in unsigned __int128.
+ * The caller supplies:
+ *
+ *   1. Space q for the quotient, m - n + 1 words (at least one).
+ *   2. Space r for the remainder (optional), n words.
+ *   3. The dividend u, m words, m >= 1.
+ *   4. The divisor v, n words, n >= 2.
+ *
+ * The most significant digit of the divisor, v[n-1], must be nonzero.
+ * The dividend u may have leading zeros; this just makes the algorithm
+ * take longer and makes the quotient contain more leading zeros.
+ * A value of NULL may be given for the address of the remainder to
+ * signify that the caller does not want the remainder.
+ *
+ *  * The program does not alter the input parameters u and v.
+ *
+ *  * The quotient and remainder returned may have leading zeros.  The
+ *    function itself returns a value of 0 for success and 1 for invalid
+ *    parameters (e.g., division by 0).
+ *
+ *  * For now, we must have m >= n.  Knuth's Algorithm D also requires
+ *    that the dividend be at least as long as the divisor.
+ *    (In his terms: "m >= 0 (unstated), therefore, m+n >= n." )
+ *
+ *  * The multiply-and-subtract step is done by the given kernel;
+ *    divmnu64() uses the one chosen by kd_div64_select().
+ */
+
+int
+divmnu64_with_kernel (uint64_t q[], uint64_t r[], const uint64_t u[],
+                      const uint64_t v[], int m, int n,
+                      kd_div64_mulsub_t mulsub);
+
+int
+divmnu64_with_kernel (uint64_t q[], uint64_t r[], const uint64_t u[],
+                      const uint64_t v[], int m, int n,
+                      kd_div64_mulsub_t mulsub)
+{
+  const uint128_t  b = (uint128_t)1 << 64;   /* Number base (2**64).      */
+  uint64_t *un, *vn;                         /* Normalized form of u, v.  */
+  uint128_t qhat;                            /* Estimated quotient digit. */
+  uint128_t rhat;                            /* A remainder.              */
+  int128_t  k;
+  int s, i, j;
+
+  if (m < n || n <= 0 || v[n - 1] == 0)
+    return 1;                                /* Return if invalid param. */
+
+  if (n == 1)
+    {
+      k = 0;
+
+      for (j = m - 1; j >= 0; j--)
+        {
+          uint128_t dig2 = ( (uint128_t)k << 64 ) | u[j];
+          q[j]           = (uint64_t)(dig2 / v[0]);
+          k              = (int128_t)(dig2 % v[0]);
+        }
+
+      if (r != NULL)
+        r[0] = (uint64_t)k;
+
+      return 0;
+    }
+
+  /*
+   * Normalize by shifting v left just enough so that its high-order
+   * bit is on, and shift u left the same amount. We may have to append a
+   * high-order digit on the dividend; we do that unconditionally.
+   */
+
+  s  = nlz64 (v[n - 1]);  /* 0 <= s <= 63. */
+  vn = (uint64_t *)alloca (8 * n);
+
+  for (i = n - 1; i > 0; i--)
+    vn[i] = (uint64_t)( (v[i] << s) |
+              ( (uint128_t)v[i - 1] >> (64 - s) ) );
+
+  vn[0] = v[0] << s;
+
+  un    = (uint64_t *)alloca ( 8 * (m + 1) );
+
+  un[m] = (uint64_t)( (uint128_t)u[m - 1] >> (64 - s) );
+
+  for (i = m - 1; i > 0; i--)
+    un[i] = (uint64_t)( (u[i] << s) |
+              ( (uint128_t)u[i - 1] >> (64 - s) ) );
+
+  un[0] = u[0] << s;
+
+  for (j = m - n; j >= 0; j--)
+    {
+
+    uint64_t *un_j = &un[j];
+
+    /* Compute estimate qhat of q[j] from top 2 digits. */
+
+    uint128_t dig2  = ( (uint128_t)un[j + n] << 64 ) | un[j + n - 1];
+    divrem64_t qr   = divrem_128_by_64 (dig2, vn[n - 1]);
+    qhat            = qr.q;
+    rhat            = qr.r;
+
+    if (qr.overflow)
+      {
+
+        /*
+         * rhat can be bigger than 64-bit when the division overflows;
+         * thus rhat computation cannot be folded into divrem_128_by_64
+         */
+
+        rhat = dig2 - (uint128_t)qr.q * vn[n - 1];
+      }
+
+again:
+
+    /* Use 3rd-from-top digit to obtain better accuracy */
+
+    /*
+     * Unlike the base 2**32 version, b * rhat cannot be formed when
+     * rhat >= b, but the rhat < b test guards that product here too.
+     */
+
+    if (rhat < b &&
+     (uint64_t)qhat * (uint128_t)vn[n - 2] >
+     (rhat << 64) + un[j + n - 2])
+      {
+        qhat = qhat - 1;
+        rhat = rhat + vn[n - 1];
+
+        if (rhat < b)
+          goto again;
+    }
+
+    /* Multiply and subtract. */
+
+    bool need_fixup = mulsub ( (uint64_t)qhat, un_j, vn, n );
+
+    q[j] = (uint64_t)qhat;  /* Store quotient digit. */
+
+    if (need_fixup)
+      {                     /* If we subtracted too */
+        q[j] = q[j] - 1;    /* much, add it back.   */
+
+        /*
+         * vn has only n digits; the carry out of the top one just
+         * cancels the borrow in un_j[n], which is not used again.
+         */
+
+        (void)bigadd64 (un_j, vn, un_j, m, n - 1, 0);
+      }
+
+  }  /* End j. */
+
+  /*
+   * If the caller wants the remainder,
+   * unnormalize it and pass it back.
+   */
+
+  if (r != NULL)
+    {
+      for (i = 0; i < n - 1; i++)
+        r[i] = (uint64_t)( (un[i] >> s) |
+                 ( (uint128_t)un[i + 1] << (64 - s) ) );
+
+      r[n - 1] = un[n - 1] >> s;
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+int
+divmnu64 (uint64_t q[], uint64_t r[], const uint64_t u[], const uint64_t v[],
+          int m, int n);
+
+int
+divmnu64 (uint64_t q[], uint64_t r[], const uint64_t u[], const uint64_t v[],
+          int m, int n)
+{
+  return divmnu64_with_kernel (q, r, u, v, m, n, kd_div64_mulsub);
+}
+
+/****************************************************************************/
+
+/*
+ * Compare q and r with the expected cq and cr.  On pass l == 1 a
+ * mismatch is reported, and counted by returning 1; otherwise 0 is
+ * returned.
+ */
+
+int
+check64 (uint64_t q[], uint64_t r[], uint64_t u[], uint64_t v[],
+         int m, int n, uint64_t cq[], uint64_t cr[], long l);
+
+int
+check64 (uint64_t q[], uint64_t r[], uint64_t u[], uint64_t v[],
+         int m, int n, uint64_t cq[], uint64_t cr[], long l)
+{
+  int i, szq;
+
+  szq = kd_div_max (m - n + 1, 1);
+
+  for (i = 0; i < szq; i++)
+    {
+      if (q[i] != cq[i])
+        {
+          if (l == 1)
+            {
+              (void)fprintf (stderr, "\n\n");
+              dumpit64 ("FATAL ERROR: dividend u =", m, u);
+              dumpit64 ("             divisor  v =", n, v);
+              dumpit64 ("             remainder  =", m - n + 1, q);
+              dumpit64 ("             should be  =", m - n + 1, cq);
+              return 1;
+            }
+
+          return 0;
+        }
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      if (r[i] != cr[i])
+        {
+          if (l == 1)
+            {
+              (void)fprintf (stderr, "\n\n");
+              dumpit64 ("FATAL ERROR: dividend u =", m, u);
+              dumpit64 ("             divisor  v =", n, v);
+              dumpit64 ("             remainder  =", n, r);
+              dumpit64 ("             should be  =", n, cr);
+              return 1;
+            }
+
+          return 0;
+        }
+    }
+
+  return 0;
+}
+
+/****************************************************************************/
+
+double
+kd_div_elapsed (const struct timespec *start);
+
+double
+kd_div_elapsed (const struct timespec *start)
+{
+  struct timespec now;
+
+  (void)clock_gettime (CLOCK_MONOTONIC, &now);
+
+  return (double)(now.tv_sec - start->tv_sec) +
+           (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/****************************************************************************/
+
+/*
+ * A test case: u / v with m- and n-word operands, and the expected
+ * quotient and remainder, or error if divmnu64() should reject it.
+ */
+
+typedef struct
+{
+  int m;
+  int n;
+  uint64_t  u[10];
+  uint64_t  v[10];
+  uint64_t cq[10];
+  uint64_t cr[10];
+  bool error;
+  char pad[7];
+} kd_div64_case_t;
+
+/****************************************************************************/
+
+/*
+ * Threads that divmnu64_test() splits its loop over (0 for one per
+ * online processor), and the divisions per second that it reached.
+ */
+
+#define KD_DIV_MAX_THREADS 256
+
+int kd_div_threads  = 0;
+double kd_div_rate  = 0.0;
+
+/****************************************************************************/
+
+/*
+ * One thread's share of the divmnu64_test() loop: passes first .. last
+ * over the table, with the errors found counted in errors.  Each thread
+ * checks its results on its second pass, as the single-threaded loop
+ * did.
+ */
+
+typedef struct
+{
+  pthread_t thread;
+  kd_div64_case_t *test;
+  long first;
+  long last;
+  int ncases;
+  unsigned errors;
+  bool started;                              /* Running in thread.       */
+  char pad[7];
+} kd_div64_worker_t;
+
+void *
+kd_div64_test_worker (void *arg);
+
+void *
+kd_div64_test_worker (void *arg)
+{
+  kd_div64_worker_t *w  = arg;
+  kd_div64_case_t *test = w->test;
+  const int ncases      = w->ncases;
+  uint64_t q[10], r[10];
+
+  for (long l = w->first; l <= w->last; l++)
+    {
+      const long pass = l - w->first;
+
+      for (int i = 0; i < ncases; i++)
+        {
+          int m        = test[i].m;
+          int n        = test[i].n;
+          uint64_t *u  = test[i].u;
+          uint64_t *v  = test[i].v;
+          uint64_t *cq = test[i].cq;
+          uint64_t *cr = test[i].cr;
+
+          int f = divmnu64 (q, r, u, v, m, n);
+
+          if (f && !test[i].error)
+            {
+              if (pass == 1)
+                {
+                  (void)fprintf (stderr, "\n\n");
+                  dumpit64 ("FATAL: Unexpected error for dividend u =", m, u);
+                  dumpit64 ("                            divisor  v =", n, v);
+                  w->errors++;
+                }
+            }
+
+          else if (!f && test[i].error)
+            {
+              if (pass == 1)
+                {
+                  (void)fprintf (stderr, "\n\n");
+                  dumpit64 ("FATAL: Unexpected success for dividend u =",
+                            m, u);
+                  dumpit64 ("                              divisor  v =",
+                            n, v);
+                  w->errors++;
+                }
+            }
+
+          if (!f)
+            w->errors += check64 (q, r, u, v, m, n, cq, cr, pass);
+        }
+    }
+
+  return NULL;
+}
+
+/****************************************************************************/
+
+int
+divmnu64_test (void);
+
+int
+divmnu64_test (void)
+{
+  static kd_div64_case_t test[] = {
+
+    { .m     = 3,
+      .n     = 1,
+      .u     = { 3 },
+      .v     = { 0 },
+      .error = true
+    },
+
+    { .m     = 1,
+      .n     = 2,
+      .u     = { 7 },
+      .v     = { 1,                  3 },
+      .error = true
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0,                  0 },
+      .v     = { 1,                  0 },
+      .error = true
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 3 },
+      .v     = { 2 },
+      .cq    = { 1 },
+      .cr    = { 1 }
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 3 },
+      .v     = { 3 },
+      .cq    = { 1 },
+      .cr    = { 0 }
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 3 },
+      .v     = { 4 },
+      .cq    = { 0 },
+      .cr    = { 3 }
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 0 },
+      .v     = { 0xffffffffffffffff },
+      .cq    = { 0 },
+      .cr    = { 0 }
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 0xffffffffffffffff },
+      .v     = { 1 },
+      .cq    = { 0xffffffffffffffff },
+      .cr    = { 0 }
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 0xffffffffffffffff },
+      .v     = { 0xffffffffffffffff },
+      .cq    = { 1 },
+      .cr    = { 0 }
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 0xffffffffffffffff },
+      .v     = { 3 },
+      .cq    = { 0x5555555555555555 },
+      .cr    = { 0 }
+    },
+
+    { .m     = 2,
+      .n     = 1,
+      .u     = { 0xffffffffffffffff, 0xffffffffffffffff },
+      .v     = { 1 },
+      .cq    = { 0xffffffffffffffff, 0xffffffffffffffff },
+      .cr    = { 0 }
+    },
+
+    { .m     = 2,
+      .n     = 1,
+      .u     = { 0xffffffffffffffff, 0xffffffffffffffff },
+      .v     = { 0xffffffffffffffff },
+      .cq    = { 1,                  1 },
+      .cr    = { 0 }
+    },
+
+    { .m     = 2,
+      .n     = 1,
+      .u     = { 0xffffffffffffffff, 0xfffffffffffffffe },
+      .v     = { 0xffffffffffffffff },
+      .cq    = { 0xffffffffffffffff, 0 },
+      .cr    = { 0xfffffffffffffffe }
+    },
+
+    { .m     = 2,
+      .n     = 1,
+      .u     = { 0x0000000056785678, 0x0000000012341234 },
+      .v     = { 0x000000009abc9abc },
+      .cq    = { 0x1e1dba76234fe799, 0 },
+      .cr    = { 0x00000000381c381c }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0,                  0 },
+      .v     = { 0,                  1 },
+      .cq    = { 0 },
+      .cr    = { 0,                  0 }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0,                  7 },
+      .v     = { 0,                  3 },
+      .cq    = { 2 },
+      .cr    = { 0,                  1 }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 5,                  7 },
+      .v     = { 0,                  3 },
+      .cq    = { 2 },
+      .cr    = { 5,                  1 }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0,                  6 },
+      .v     = { 0,                  2 },
+      .cq    = { 3 },
+      .cr    = { 0,                  0 }
+    },
+
+    { .m     = 1,
+      .n     = 1,
+      .u     = { 0x8000000000000000 },
+      .v     = { 0x4000000000000001 },
+      .cq    = { 1 },
+      .cr    = { 0x3fffffffffffffff }
+    },
+
+    { .m     = 2,
+      .n     = 1,
+      .u     = { 0,                  0x8000000000000000 },
+      .v     = { 0x4000000000000001 },
+      .cq    = { 0xfffffffffffffff8, 1 },
+      .cr    = { 0x0000000000000008 }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0,                  0x8000000000000000 },
+      .v     = { 1,                  0x4000000000000000 },
+      .cq    = { 1 },
+      .cr    = { 0xffffffffffffffff, 0x3fffffffffffffff }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0x00000000789a789a, 0x00000000bcdebcde },
+      .v     = { 0x00000000789a789a, 0x00000000bcdebcde },
+      .cq    = { 1 },
+      .cr    = { 0,                  0 }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0x00000000789b789b, 0x00000000bcdebcde },
+      .v     = { 0x00000000789a789a, 0x00000000bcdebcde },
+      .cq    = { 1 },
+      .cr    = { 0x0000000000010001, 0 }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0x0000000078997899, 0x00000000bcdebcde },
+      .v     = { 0x00000000789a789a, 0x00000000bcdebcde },
+      .cq    = { 0 },
+      .cr    = { 0x0000000078997899, 0x00000000bcdebcde }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0x00000000ffffffff, 0x00000000ffffffff },
+      .v     = { 0x00000000ffffffff, 0x00000000ffffffff },
+      .cq    = { 1 },
+      .cr    = { 0,                  0 }
+    },
+
+    { .m     = 2,
+      .n     = 2,
+      .u     = { 0x00000000ffffffff, 0x00000000ffffffff },
+      .v     = { 0,                  1 },
+      .cq    = { 0x00000000ffffffff },
+      .cr    = { 0x00000000ffffffff, 0 }
+    },
+
+    { .m     = 3,
+      .n     = 2,
+      .u     = { 0x0000000089ab89ab, 0x0000000045674567,
+                 0x0000000001230123 },
+      .v     = { 0,                  1 },
+      .cq    = { 0x0000000045674567, 0x0000000001230123 },
+      .cr    = { 0x0000000089ab89ab, 0 }
+    },
+
+    { .m     = 3,
+      .n     = 2,
+      .u     = { 0,                  0x00000000fffffffe,
+                 0x0000000080000000 },
+      .v     = { 0x00000000ffffffff, 0x0000000080000000 },
+      .cq    = { 0xffffffffffffffff, 0 },
+      .cr    = { 0x00000000ffffffff, 0x000000007fffffff }
+    },
+
+    { .m     = 3,
+      .n     = 3,
+      .u     = { 3,                  0,
+                 0x8000000000000000 },
+      .v     = { 1,                  0,
+                 0x2000000000000000 },
+      .cq    = { 3 },
+      .cr    = { 0,                  0,
+                 0x2000000000000000 }
+    },
+
+    { .m     = 3,
+      .n     = 3,
+      .u     = { 3,                  0,
+                 0x0000000080000000 },
+      .v     = { 1,                  0,
+                 0x0000000020000000 },
+      .cq    = { 3 },
+      .cr    = { 0,                  0,
+                 0x0000000020000000 }
+    },
+
+    { .m     = 4,
+      .n     = 3,
+      .u     = { 0,                  0,
+                 0x0000000080000000, 0x000000007fffffff },
+      .v     = { 1,                  0,
+                 0x0000000080000000 },
+      .cq    = { 0xfffffffe00000000, 0 },
+      .cr    = { 0x0000000200000000, 0xffffffffffffffff,
+                 0x000000007fffffff }
+    },
+
+    { .m     = 4,
+      .n     = 3,
+      .u     = { 0,                  0x00000000fffffffe,
+                 0,                  0x0000000080000000 },
+      .v     = { 0x00000000ffffffff, 0,
+                 0x0000000080000000 },
+      .cq    = { 0xffffffffffffffff, 0 },
+      .cr    = { 0x00000000ffffffff, 0xffffffffffffffff,
+                 0x000000007fffffff }
+    },
+
+    { .m     = 4,
+      .n     = 3,
+      .u     = { 0,                  0xfffffffffffffffe,
+                 0,                  0x8000000000000000 },
+      .v     = { 0x00000000ffffffff, 0,
+                 0x8000000000000000 },
+      .cq    = { 0,                  1 },
+      .cr    = { 0,                  0xfffffffeffffffff,
+                 0 }
+    },
+
+    { .m     = 4,
+      .n     = 3,
+      .u     = { 0,                  0xfffffffffffffffe,
+                 0,                  0x8000000000000000 },
+      .v     = { 0xffffffffffffffff, 0,
+                 0x8000000000000000 },
+      .cq    = { 0xffffffffffffffff, 0 },
+      .cr    = { 0xffffffffffffffff, 0xffffffffffffffff,
+                 0x7fffffffffffffff }
+    },
+  };
+
+  unsigned errors  = 0;
+  const int ncases = sizeof (test) / sizeof (test[0]);
+  const long loops = 12000000L;
+
+  int nthreads = kd_div_threads > 0 ? kd_div_threads :
+                   (int)sysconf (_SC_NPROCESSORS_ONLN);
+  kd_div64_worker_t w[KD_DIV_MAX_THREADS];
+  struct timespec start;
+
+  if (nthreads < 1)
+    nthreads = 1;
+  else if (nthreads > KD_DIV_MAX_THREADS)
+    nthreads = KD_DIV_MAX_THREADS;
+
+  /*
+   * Split the passes over the table evenly between the threads.  The
+   * calling thread takes the first share, and also any share whose
+   * thread could not be started.
+   */
+
+  (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+  for (int t = 0; t < nthreads; t++)
+    {
+      w[t].test    = test;
+      w[t].ncases  = ncases;
+      w[t].first   = (loops + 1) * t / nthreads;
+      w[t].last    = (loops + 1) * (t + 1) / nthreads - 1;
+      w[t].errors  = 0;
+      w[t].started = t > 0 &&
+        pthread_create (&w[t].thread, NULL, kd_div64_test_worker, &w[t]) == 0;
+    }
+
+  for (int t = 0; t < nthreads; t++)
+    {
+      if (w[t].started)
+        (void)pthread_join (w[t].thread, NULL);
+      else
+        (void)kd_div64_test_worker (&w[t]);
+
+      errors += w[t].errors;
+    }
+
+  kd_div_rate = (double)(loops + 1) * ncases / kd_div_elapsed (&start);
+
+  if (errors > 0)
+    return 1;
+  else
+    return 0;
+}
+
+/****************************************************************************/
+
+/*
+ * Usage: divmnu64 [-j threads] [kernel ...]
+ *
+ * Runs divmnu64_test() with each of the named kernels, or with all of the
+ * kernels in kd_div64_kernels[] if none are named.  When more than one
+ * kernel is run, or -j is given, the elapsed time and divisions per
+ * second of each are printed, so the variants can be compared in one
+ * process on the same inputs.  -j sets the number of threads
+ * divmnu64_test() uses (default: one per online processor).
+ */
+
+int
+main (int argc, char *argv[]);
+
+int
+main (int argc, char *argv[])
+{
+  int first = 1;
+
+  if (argc > 2 && strcmp (argv[1], "-j") == 0)
+    {
+      kd_div_threads = atoi (argv[2]);
+      first          = 3;
+
+      if (kd_div_threads <= 0)
+        {
+          (void)fprintf (stderr, "%s: invalid thread count \"%s\"\n",
+                         argv[0], argv[2]);
+
+          return 2;
+        }
+    }
+
+  int nrun   = argc > first ? argc - first : kd_div64_nkernels;
+  int failed = 0;
+
+  for (int i = 0; i < nrun; i++)
+    {
+      const kd_div64_kernel_t *kernel;
+      struct timespec start;
+
+      if (argc > first)
+        kernel = kd_div64_find (argv[first + i]);
+      else
+        kernel = &kd_div64_kernels[i];
+
+      if (kernel == NULL)
+        {
+          (void)fprintf (stderr, "%s: unknown kernel \"%s\"\n",
+                         argv[0], argv[first + i]);
+          return 2;
+        }
+
+      kd_div64_mulsub = kernel->mulsub;
+
+      (void)clock_gettime (CLOCK_MONOTONIC, &start);
+
+      int error = divmnu64_test ();
+
+      if (nrun > 1 || first > 1)
+        (void)printf ("%-24s %s %8.2f s %8.2f Mdiv/s\n", kernel->name,
+                      error ? "FAILED" : "ok    ", kd_div_elapsed (&start),
+                      kd_div_rate / 1e6);
+
+      failed += error;
+    }
+
+  return failed != 0;
+}